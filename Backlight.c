@@ -25,8 +25,11 @@ Revision:			$Rev:  $
 //API implementation includes.
 #include <linux/types.h>
 #include <stdbool.h>
+#include <string.h>
+#include <errno.h>
 #include <unistd.h>
 #include <time.h>
+#include <pthread.h>
 #include <fcntl.h>
 #include <sys/ioctl.h>
 #include <linux/spi/spidev.h>
@@ -34,20 +37,47 @@ Revision:			$Rev:  $
 #include "STREAM_macros.h"
 
 
-//////////////////////////////////////////////////
-#define SHIFT_REGISTER_LENGTH_BITS 224
-#define SHIFT_REGISTER_LENGTH_BYTES (SHIFT_REGISTER_LENGTH_BITS / 8)
+//The fixed part of each chip's 32-bit command. The brightness bits are
+//ORed in below it.
+#define BACKLIGHT_COMMAND_HEADER ( \
+	(0x25u	<< 26) |	/*Write command code.*/ \
+	(0x01u	<< 25) |	/*OUTTMG*/ \
+	(0x00u	<< 24) |	/*EXTGCK*/ \
+	(0x01u	<< 23) |	/*TMGRST*/ \
+	(0x01u	<< 22) |	/*DSPRPT*/ \
+	(0x00u	<< 21))		/*BLANK*/
+#define BACKLIGHT_COMMAND(red, green, blue) \
+	(BACKLIGHT_COMMAND_HEADER | ((uint32_t)(blue) << 14) | ((uint32_t)(green) << 7) | (uint32_t)(red))
 
-#define FIELD_TO_TX_BUFFER(type, value) \
-	TYPE_ENDIAN_TO_STREAM_ITERATOR(type, BE_, tx, iterator, value)
+//Where each field sits in tx. The chips are sent last to first, and each
+//one's grayscale goes out from OUTB3 down to OUTR0.
+#define COMMAND_OFFSET(chip) \
+	((BACKLIGHT_CHIPS - 1 - (chip)) * SHIFT_REGISTER_LENGTH_BYTES)
+#define GRAYSCALE_OFFSET(channel) \
+	(COMMAND_OFFSET((channel) / BACKLIGHT_CHANNELS_PER_CHIP) + 4 + \
+	(BACKLIGHT_CHANNELS_PER_CHIP - 1 - (channel) % BACKLIGHT_CHANNELS_PER_CHIP) * 2)
+
+#define FIELD_TO_TX_BUFFER(type, offset, value) \
+	TYPE_ENDIAN_TO_STREAM_OFFSET(type, BE_, tx, offset, value)
 
 
 //======================================================================
 //! Private variables.
-static BacklightBrightness gBrightness1 = BACKLIGHT_BRIGHTNESS_DEFAULT;
-static BacklightBrightness gBrightness2 = BACKLIGHT_BRIGHTNESS_DEFAULT;
-static BacklightGrayscale gGrayscale1 = BACKLIGHT_GRAYSCALE_DEFAULT;
-static BacklightGrayscale gGrayscale2 = BACKLIGHT_GRAYSCALE_DEFAULT;
+//Brightness of each color on each chip. All start at the default.
+static BacklightBrightness gBrightness[BACKLIGHT_CHIPS][BacklightColorCOUNT] = 
+{
+	[0 ... BACKLIGHT_CHIPS - 1] = 
+	{
+		[0 ... BacklightColorCOUNT - 1] = BACKLIGHT_BRIGHTNESS_DEFAULT
+	}
+};
+
+//Grayscale of each channel. Only the two backlight LEDs start on.
+static BacklightGrayscale gGrayscale[BACKLIGHT_CHANNELS] = 
+{
+	[BACKLIGHT_LED1_CHANNEL] = BACKLIGHT_GRAYSCALE_DEFAULT,
+	[BACKLIGHT_LED2_CHANNEL] = BACKLIGHT_GRAYSCALE_DEFAULT
+};
 
 static const char *device = "/dev/spidev2.0";
 static uint8_t mode;
@@ -55,7 +85,33 @@ static uint8_t bits = 8;
 static uint32_t speed = 500000;
 static uint16_t delay;
 
-static uint8_t tx[SHIFT_REGISTER_LENGTH_BYTES];
+//The packet is built once and then patched as levels change.
+static uint8_t tx[BACKLIGHT_PACKET_BYTES];
+static bool gTxBuilt = false;
+
+//SPI session. The device stays open and configured between updates.
+static int gFd = -1;
+static struct spi_ioc_transfer gTransfer;
+
+//Write combining. The lock covers the levels, the session and the flusher.
+//gSent holds the packet the chain last received, if gSentValid.
+static pthread_mutex_t gLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t gFlushWake;
+static pthread_t gFlushThread;
+static bool gFlushStarted = false;
+static bool gFlushStop = false;
+static bool gPending = false;
+static struct timespec gFlushDeadline;
+static uint32_t gCombineUS = BACKLIGHT_COMBINE_US;
+static BacklightErrEnum gFlushErr = BacklightNoErr;
+static uint8_t gSent[ARRAY_SIZE(tx)];
+static bool gSentValid = false;
+static uint32_t gSentCount = 0;
+static uint32_t gSkippedCount = 0;
+
+//Replaces the spi device when set.
+static BacklightTransferHook gTransferHook = NULL;
+static void *gTransferContext = NULL;
 
 static const char * backlightErrDescs[BacklightErrCOUNT] = 
 {
@@ -67,6 +123,12 @@ static const char * backlightErrDescs[BacklightErrCOUNT] =
 //======================================================================
 //! Private prototypes.
 static void BacklightFillTX(void);
+static void BacklightPatchCommand(uint16_t chip);
+static void BacklightPatchGrayscale(uint16_t channel);
+static BacklightErrEnum BacklightOpenLocked(void);
+static void BacklightCloseLocked(void);
+static BacklightErrEnum BacklightSendLocked(void);
+static BacklightErrEnum BacklightStartWindowLocked(void);
 
 //======================================================================
 /*!
@@ -85,7 +147,7 @@ LEDs is optional.
 @return		BacklightNoErr or errors returned if LEDs are updated.
 @param	led1	Brightness value for backlight LED 1.
 @param	led2	Brightness value for backlight LED 2.
-@param	update	If true then the LEDs will be updated immediately.
+@param	update	If true then the LEDs will be updated.
 
 @author	John Heaney
 @test	12/06/2016 Unit Test: UNTESTED
@@ -96,15 +158,18 @@ BacklightErrEnum SetBrightness(BacklightBrightness led1, BacklightBrightness led
 
 	result = BacklightNoErr;
 
+	pthread_mutex_lock(&gLock);
 	if (led1 > BACKLIGHT_BRIGHTNESS_MAX)
-		gBrightness1 = BACKLIGHT_BRIGHTNESS_MAX;
+		gBrightness[0][BacklightRed] = BACKLIGHT_BRIGHTNESS_MAX;
 	else
-		gBrightness1 = led1;
+		gBrightness[0][BacklightRed] = led1;
 
 	if (led2 > BACKLIGHT_BRIGHTNESS_MAX)
-		gBrightness2 = BACKLIGHT_BRIGHTNESS_MAX;
+		gBrightness[0][BacklightGreen] = BACKLIGHT_BRIGHTNESS_MAX;
 	else
-		gBrightness2 = led2;
+		gBrightness[0][BacklightGreen] = led2;
+	BacklightPatchCommand(0);
+	pthread_mutex_unlock(&gLock);
 
 	if (update)
 	{
@@ -130,7 +195,7 @@ LEDs is optional.
 @return		BacklightNoErr or errors returned if LEDs are updated.
 @param	led1	Grayscale value for backlight LED 1.
 @param	led2	Grayscale value for backlight LED 2.
-@param	update	If true then the LEDs will be updated immediately.
+@param	update	If true then the LEDs will be updated.
 
 @author	John Heaney
 @test	12/06/2016 Unit Test: UNTESTED
@@ -141,8 +206,99 @@ BacklightErrEnum SetGrayscale(BacklightGrayscale led1, BacklightGrayscale led2,
 
 	result = BacklightNoErr;
 
-	gGrayscale1 = led1;
-	gGrayscale2 = led2;
+	pthread_mutex_lock(&gLock);
+	gGrayscale[BACKLIGHT_LED1_CHANNEL] = led1;
+	gGrayscale[BACKLIGHT_LED2_CHANNEL] = led2;
+	BacklightPatchGrayscale(BACKLIGHT_LED1_CHANNEL);
+	BacklightPatchGrayscale(BACKLIGHT_LED2_CHANNEL);
+	pthread_mutex_unlock(&gLock);
+
+	if (update)
+	{
+		result = BacklightUpdateLEDs();
+	}
+	return result;
+}
+
+//======================================================================
+/*!
+@brief	Set the brightness levels of one chip and optionally update the LEDs.
+@details
+Each chip in the chain has a 7 bit brightness for each color, applied to
+that color on all four of its outputs. SetBrightness sets red and green
+on chip 0, which are backlight LEDs 1 and 2.
+
+@return		BacklightNoErr, BacklightRangeErr or errors returned if LEDs are updated.
+@param	chip	The chip, 0 being the first one on the bus.
+@param	red		Brightness value for the red outputs.
+@param	green	Brightness value for the green outputs.
+@param	blue	Brightness value for the blue outputs.
+@param	update	If true then the LEDs will be updated.
+*/
+BacklightErrEnum SetChipBrightness(
+	uint16_t chip,
+	BacklightBrightness red,
+	BacklightBrightness green,
+	BacklightBrightness blue,
+	bool update)
+{
+	BacklightErrEnum	result;
+
+	result = BacklightNoErr;
+
+	if (chip >= BACKLIGHT_CHIPS)
+		return BacklightRangeErr;
+
+	pthread_mutex_lock(&gLock);
+	gBrightness[chip][BacklightRed] = (red > BACKLIGHT_BRIGHTNESS_MAX) ? BACKLIGHT_BRIGHTNESS_MAX : red;
+	gBrightness[chip][BacklightGreen] = (green > BACKLIGHT_BRIGHTNESS_MAX) ? BACKLIGHT_BRIGHTNESS_MAX : green;
+	gBrightness[chip][BacklightBlue] = (blue > BACKLIGHT_BRIGHTNESS_MAX) ? BACKLIGHT_BRIGHTNESS_MAX : blue;
+	BacklightPatchCommand(chip);
+	pthread_mutex_unlock(&gLock);
+
+	if (update)
+	{
+		result = BacklightUpdateLEDs();
+	}
+	return result;
+}
+
+//======================================================================
+/*!
+@brief	Set the grayscale levels of a run of channels and optionally update the LEDs.
+@details
+Channels are numbered through the chain as described in Backlight.h, so
+the run can cover outputs on several chips. Use BACKLIGHT_CHANNEL to number
+one output. Nothing is changed if the run goes past the last channel.
+
+@return		BacklightNoErr, BacklightRangeErr or errors returned if LEDs are updated.
+@param	first		The first channel to set.
+@param	count		The number of channels to set.
+@param	grayscale	count grayscale values.
+@param	update		If true then the LEDs will be updated.
+*/
+BacklightErrEnum SetChannelGrayscale(
+	uint16_t first,
+	uint16_t count,
+	const BacklightGrayscale *grayscale,
+	bool update)
+{
+	BacklightErrEnum	result;
+	uint16_t			i;
+
+	result = BacklightNoErr;
+
+	if ((uint32_t)first + count > BACKLIGHT_CHANNELS)
+		return BacklightRangeErr;
+
+	pthread_mutex_lock(&gLock);
+	for (i = 0; i < count; i++)
+	{
+		gGrayscale[first + i] = grayscale[i];
+		BacklightPatchGrayscale(first + i);
+	}
+	pthread_mutex_unlock(&gLock);
+
 	if (update)
 	{
 		result = BacklightUpdateLEDs();
@@ -161,7 +317,7 @@ BacklightErrEnum SetGrayscale(BacklightGrayscale led1, BacklightGrayscale led2,
 */
 BacklightBrightness	GetBrightness1(void)
 {
-	return gBrightness1;
+	return gBrightness[0][BacklightRed];
 }
 
 //======================================================================
@@ -175,7 +331,7 @@ BacklightBrightness	GetBrightness1(void)
 */
 BacklightBrightness	GetBrightness2(void)
 {
-	return gBrightness2;
+	return gBrightness[0][BacklightGreen];
 }
 
 //======================================================================
@@ -189,7 +345,7 @@ BacklightBrightness	GetBrightness2(void)
 */
 BacklightGrayscale	GetGrayscale1(void)
 {
-	return gGrayscale1;
+	return gGrayscale[BACKLIGHT_LED1_CHANNEL];
 }
 
 
@@ -204,17 +360,53 @@ BacklightGrayscale	GetGrayscale1(void)
 */
 BacklightGrayscale	GetGrayscale2(void)
 {
-	return gGrayscale2;
+	return gGrayscale[BACKLIGHT_LED2_CHANNEL];
+}
+
+//======================================================================
+/*!
+@brief	Return the brightness level of one color on one chip.
+
+@return		Brightness level, or 0 if the chip is out of range.
+@param	chip	The chip, 0 being the first one on the bus.
+@param	color	The color.
+*/
+BacklightBrightness	GetChipBrightness(uint16_t chip, BacklightColorEnum color)
+{
+	if (chip >= BACKLIGHT_CHIPS || color >= BacklightColorCOUNT)
+		return BACKLIGHT_BRIGHTNESS_MIN;
+	return gBrightness[chip][color];
+}
+
+//======================================================================
+/*!
+@brief	Return the grayscale level of one channel.
+
+@return		Grayscale level, or 0 if the channel is out of range.
+@param	channel	The channel.
+*/
+BacklightGrayscale	GetChannelGrayscale(uint16_t channel)
+{
+	if (channel >= BACKLIGHT_CHANNELS)
+		return BACKLIGHT_GRAYSCALE_MIN;
+	return gGrayscale[channel];
 }
 
 
 //======================================================================
 /*!
 @brief	Fill the buffer to tranmit to via the spi bus.
-The buffer begins with some control bits for the command. It is followed
-by the master brightness values and then RGB values for each of four
-color LEDs. In this implementation R0 and G0 are used for backlight LED
-1 and 2, respectively.
+Each chip's packet begins with some control bits for the command. It is
+followed by the master brightness values and then RGB values for each of
+four color LEDs. In this implementation R0 and G0 of the first chip are
+used for backlight LED 1 and 2, respectively.
+
+The packets are shifted through the chain, so the first one sent ends up
+in the last chip. The chips are filled last to first.
+
+This is only done for the first send. After that the Set functions patch
+the fields they change in place.
+@see BacklightPatchCommand, BacklightPatchGrayscale
 
 @return		None.
 
@@ -223,77 +415,103 @@ color LEDs. In this implementation R0 and G0 are used for backlight LED
 */
 static void BacklightFillTX(void)
 {
-	uint32_t	command;
-	int			iterator;
-
-	//SPI transmits in both directions, so this buffer captures whatever comes back.
-	// We don't care about it. It will be ignored.
-	uint8_t rx[ARRAY_SIZE(tx)];
-
-	//The first 32 bits include the command to write, flags and global brightness.
-	SHIFT_BITS_FROM_RIGHT(command	,0x25			,6);	//Write command code.
-	SHIFT_BITS_FROM_RIGHT(command	,0x01			,1);	//OUTTMG 
-	SHIFT_BITS_FROM_RIGHT(command	,0x00			,1);	//EXTGCK
-	SHIFT_BITS_FROM_RIGHT(command	,0x01			,1);	//TMGRST
-	SHIFT_BITS_FROM_RIGHT(command	,0x01			,1);	//DSPRPT 
-	SHIFT_BITS_FROM_RIGHT(command	,0x00			,1);	//BLANK 
-	SHIFT_BITS_FROM_RIGHT(command	,0x00			,7);	//Blue brightness unused.
-	SHIFT_BITS_FROM_RIGHT(command	,gBrightness2	,7);	//Green brightness
-	SHIFT_BITS_FROM_RIGHT(command	,gBrightness1	,7);	//Red brightness
-
-	//Build up the transmit buffer from the start.
-	iterator = 0;
-	FIELD_TO_TX_BUFFER(UINT32_, command);
-	FIELD_TO_TX_BUFFER(UINT16_, 0); //OUTB3
-	FIELD_TO_TX_BUFFER(UINT16_, 0); //OUTG3
-	FIELD_TO_TX_BUFFER(UINT16_, 0); //OUTR3
-	FIELD_TO_TX_BUFFER(UINT16_, 0); //OUTB2
-	FIELD_TO_TX_BUFFER(UINT16_, 0); //OUTG2
-	FIELD_TO_TX_BUFFER(UINT16_, 0); //OUTR2
-	FIELD_TO_TX_BUFFER(UINT16_, 0); //OUTB1
-	FIELD_TO_TX_BUFFER(UINT16_, 0); //OUTG1
-	FIELD_TO_TX_BUFFER(UINT16_, 0); //OUTR1
-	FIELD_TO_TX_BUFFER(UINT16_, 0); //OUTB0
-	FIELD_TO_TX_BUFFER(UINT16_, gGrayscale2); //OUTG0
-	FIELD_TO_TX_BUFFER(UINT16_, gGrayscale1); //OUTR0
+	uint16_t	chip;
+	uint16_t	channel;
+
+	gTxBuilt = true;
+	for (chip = 0; chip < BACKLIGHT_CHIPS; chip++)
+	{
+		BacklightPatchCommand(chip);
+	}
+	for (channel = 0; channel < BACKLIGHT_CHANNELS; channel++)
+	{
+		BacklightPatchGrayscale(channel);
+	}
 }
 
 //======================================================================
 /*!
-@brief	Update the backlight LEDs.
-This function uses the stored brightness and grayscale values for both
-LEDs and creates a spi command message. It sends the command via the
-linux ioctl driver for the spi bus.
+@brief	Write one chip's command and brightness into the transmit buffer.
+The constant bits come from BACKLIGHT_COMMAND_HEADER, so only the three
+brightness fields are merged in. Nothing is written before the buffer
+is first filled, since filling it picks up the stored values.
+
+@return		None.
+@param	chip	The chip, 0 being the first one on the bus.
+*/
+static void BacklightPatchCommand(uint16_t chip)
+{
+	uint32_t	offset;
+
+	if (!gTxBuilt)
+		return;
+
+	offset = COMMAND_OFFSET(chip);
+	FIELD_TO_TX_BUFFER(UINT32_, offset, BACKLIGHT_COMMAND(
+		gBrightness[chip][BacklightRed],
+		gBrightness[chip][BacklightGreen],
+		gBrightness[chip][BacklightBlue]));
+}
+
+//======================================================================
+/*!
+@brief	Write one channel's grayscale into the transmit buffer.
+Nothing is written before the buffer is first filled.
+
+@return		None.
+@param	channel	The channel, numbered as in Backlight.h.
+*/
+static void BacklightPatchGrayscale(uint16_t channel)
+{
+	uint32_t	offset;
+
+	if (!gTxBuilt)
+		return;
+
+	offset = GRAYSCALE_OFFSET(channel);
+	FIELD_TO_TX_BUFFER(UINT16_, offset, gGrayscale[channel]);
+}
+
+//======================================================================
+/*!
+@brief	Open the backlight spi session.
+@details
+Opens the spi device and sets its mode, bits per word and speed once, so
+each update after this is a single transfer ioctl. Opening a session that
+is already open does nothing. BacklightUpdateLEDs opens the session itself
+if needed, so calling this first is optional. It reports configuration
+errors up front.
+@see BacklightClose
 
 @return		BacklightNoErr | spi bus errors.
+*/
+BacklightErrEnum BacklightOpen(void)
+{
+	BacklightErrEnum	result;
 
-@author	John Heaney
-@test	12/06/2016 Unit Test: UNTESTED
+	pthread_mutex_lock(&gLock);
+	result = BacklightOpenLocked();
+	pthread_mutex_unlock(&gLock);
+	return result;
+}
+
+//======================================================================
+/*!
+@brief	Open the backlight spi session with the lock held.
+@see BacklightOpen
+
+@return		BacklightNoErr | spi bus errors.
 */
-BacklightErrEnum BacklightUpdateLEDs(void)
+static BacklightErrEnum BacklightOpenLocked(void)
 {
 	int					ret;
 	int					fd;
 	BacklightErrEnum	result;
 
-	result = BacklightNoErr;
-
-	//SPI transmits in both directions, so this buffer captures whatever comes back.
-	// We don't care about it. It will be ignored.
-	uint8_t rx[ARRAY_SIZE(tx)];
-
-	//Parameter ioctl block for the spi driver.
-	struct spi_ioc_transfer tr = 
-	{
-		.tx_buf = (unsigned long)tx,
-		.rx_buf = (unsigned long)rx,
-		.len = ARRAY_SIZE(tx),
-		.delay_usecs = delay,
-		.speed_hz = speed,
-		.bits_per_word = bits,
-	};
+	if (gFd >= 0 || gTransferHook != NULL)
+		return BacklightNoErr;
 
-	BacklightFillTX();
+	result = BacklightNoErr;
 
 	fd = open(device, O_RDWR);
 	if (fd < 0)
@@ -326,19 +544,376 @@ BacklightErrEnum BacklightUpdateLEDs(void)
 		}
 	}
 
-	if (ret >= 0)
+	if (BacklightNoErr != result)
+	{
+		close(fd);
+		return result;
+	}
+
+	//Parameter ioctl block for the spi driver. Nothing useful comes back
+	// from the controller, so no receive buffer is given.
+	gTransfer = (struct spi_ioc_transfer)
+	{
+		.tx_buf = (unsigned long)tx,
+		.rx_buf = 0,
+		.len = ARRAY_SIZE(tx),
+		.delay_usecs = delay,
+		.speed_hz = speed,
+		.bits_per_word = bits,
+	};
+	gFd = fd;
+	return result;
+}
+
+//======================================================================
+/*!
+@brief	Close the backlight spi session.
+Any update still waiting for its combine window is sent first. The LEDs
+keep their current state. Closing a session that is not open does nothing.
+@see BacklightOpen
+
+@return		None.
+*/
+void BacklightClose(void)
+{
+	pthread_mutex_lock(&gLock);
+
+	if (gFlushStarted)
 	{
-		ret = ioctl(fd, SPI_IOC_MESSAGE(1), &tr);
-		if (ret < 1)
+		gFlushStop = true;
+		pthread_cond_signal(&gFlushWake);
+		pthread_mutex_unlock(&gLock);
+		pthread_join(gFlushThread, NULL);
+		pthread_mutex_lock(&gLock);
+		pthread_cond_destroy(&gFlushWake);
+		gFlushStarted = false;
+	}
+
+	if (gPending)
+	{
+		gPending = false;
+		BacklightSendLocked();
+	}
+	BacklightCloseLocked();
+
+	pthread_mutex_unlock(&gLock);
+}
+
+//======================================================================
+/*!
+@brief	Close the backlight spi device with the lock held.
+Another program may write the chain while the session is closed, so the
+next session sends its first packet even if it matches the last one.
+
+@return		None.
+*/
+static void BacklightCloseLocked(void)
+{
+	if (gFd >= 0)
+	{
+		close(gFd);
+		gFd = -1;
+	}
+	gSentValid = false;
+}
+
+//======================================================================
+/*!
+@brief	Send the stored levels to the chain with the lock held.
+The packet is filled on the first send and kept up to date by the Set
+functions after that. It is compared to the last one sent. If they match the
+chain already shows these levels and nothing is sent. If the send fails
+the session is closed, so the next update opens and configures the device
+again.
+
+@return		BacklightNoErr | spi bus errors.
+*/
+static BacklightErrEnum BacklightSendLocked(void)
+{
+	int					ret;
+	BacklightErrEnum	result;
+
+	result = BacklightOpenLocked();
+	if (BacklightNoErr != result)
+		return result;
+
+	if (!gTxBuilt)
+		BacklightFillTX();
+
+	if (gSentValid && memcmp(tx, gSent, sizeof(tx)) == 0)
+	{
+		gSkippedCount++;
+		return BacklightNoErr;
+	}
+
+	if (gTransferHook != NULL)
+		ret = gTransferHook(tx, sizeof(tx), gTransferContext);
+	else
+		ret = ioctl(gFd, SPI_IOC_MESSAGE(1), &gTransfer);
+	if (ret < 1)
+	{
+		BacklightCloseLocked();
+		return BacklightSpiSendErr;
+	}
+
+	memcpy(gSent, tx, sizeof(tx));
+	gSentValid = true;
+	gSentCount++;
+	return result;
+}
+
+//======================================================================
+/*!
+@brief	Flusher thread. Sends pending updates when their window ends.
+@details
+Sleeps until an update is pending, then until the absolute end of its
+combine window on the monotonic clock. A flush before then clears the
+pending flag, and the thread goes back to waiting. A send error is kept
+and returned by the next BacklightUpdateLEDs or BacklightFlush.
+
+@return		NULL.
+*/
+static void *BacklightFlushThread(void *arg)
+{
+	BacklightErrEnum	err;
+
+	(void)arg;
+
+	pthread_mutex_lock(&gLock);
+	while (!gFlushStop)
+	{
+		if (!gPending || BACKLIGHT_COMBINE_UNTIL_FLUSH == gCombineUS)
+		{
+			pthread_cond_wait(&gFlushWake, &gLock);
+			continue;
+		}
+
+		if (pthread_cond_timedwait(&gFlushWake, &gLock, &gFlushDeadline) != ETIMEDOUT)
+			continue;
+
+		if (gPending && !gFlushStop)
+		{
+			gPending = false;
+			err = BacklightSendLocked();
+			if (BacklightNoErr != err)
+				gFlushErr = err;
+		}
+	}
+	pthread_mutex_unlock(&gLock);
+	return NULL;
+}
+
+//======================================================================
+/*!
+@brief	Update the backlight LEDs.
+This function marks the stored brightness and grayscale values as needing
+to be sent. The first update starts the combine window, and the whole
+chain is sent once when it ends, however many updates came in between.
+With a window of 0 the values are sent before this returns.
+The spi session is opened first if it is not open, so open and
+configuration errors come back at once. An error from a combined send
+comes back from the next update or flush.
+@see BacklightFlush, BacklightSetCombineWindow
+
+@return		BacklightNoErr | spi bus errors.
+
+@author	John Heaney
+@test	12/06/2016 Unit Test: UNTESTED
+*/
+BacklightErrEnum BacklightUpdateLEDs(void)
+{
+	BacklightErrEnum	result;
+	BacklightErrEnum	deferred;
+
+	pthread_mutex_lock(&gLock);
+
+	deferred = gFlushErr;
+	gFlushErr = BacklightNoErr;
+
+	if (0 == gCombineUS)
+	{
+		gPending = false;
+		result = BacklightSendLocked();
+	}
+	else
+	{
+		result = BacklightOpenLocked();
+		if (BacklightNoErr == result && !gPending)
 		{
-			result = BacklightSpiSendErr;
+			result = BacklightStartWindowLocked();
 		}
 	}
 
-	close(fd);
+	pthread_mutex_unlock(&gLock);
+
+	if (BacklightNoErr != deferred)
+		return deferred;
 	return result;
 }
 
+//======================================================================
+/*!
+@brief	Start a combine window with the lock held.
+Starts the flusher thread the first time. If it can't be started the
+levels are sent at once instead.
+
+@return		BacklightNoErr | spi bus errors.
+*/
+static BacklightErrEnum BacklightStartWindowLocked(void)
+{
+	pthread_condattr_t	attr;
+	uint64_t			nsec;
+
+	if (!gFlushStarted)
+	{
+		//Deadlines are on the monotonic clock.
+		pthread_condattr_init(&attr);
+		pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+		pthread_cond_init(&gFlushWake, &attr);
+		pthread_condattr_destroy(&attr);
+
+		gFlushStop = false;
+		if (pthread_create(&gFlushThread, NULL, BacklightFlushThread, NULL) != 0)
+		{
+			pthread_cond_destroy(&gFlushWake);
+			return BacklightSendLocked();
+		}
+		gFlushStarted = true;
+	}
+
+	//The window starts with the first update since the last send.
+	clock_gettime(CLOCK_MONOTONIC, &gFlushDeadline);
+	if (BACKLIGHT_COMBINE_UNTIL_FLUSH != gCombineUS)
+	{
+		nsec = gFlushDeadline.tv_nsec + (uint64_t)gCombineUS * 1000;
+		gFlushDeadline.tv_sec += nsec / 1000000000;
+		gFlushDeadline.tv_nsec = nsec % 1000000000;
+	}
+	gPending = true;
+	pthread_cond_signal(&gFlushWake);
+	return BacklightNoErr;
+}
+
+//======================================================================
+/*!
+@brief	Send the stored levels now.
+Ends the combine window early. The chain gets the stored values before
+this returns, even if no update was requested, unless it already shows
+them.
+
+@return		BacklightNoErr | spi bus errors.
+*/
+BacklightErrEnum BacklightFlush(void)
+{
+	BacklightErrEnum	result;
+
+	pthread_mutex_lock(&gLock);
+
+	gPending = false;
+	result = BacklightSendLocked();
+	if (BacklightNoErr == result)
+		result = gFlushErr;
+	gFlushErr = BacklightNoErr;
+
+	pthread_mutex_unlock(&gLock);
+	return result;
+}
+
+//======================================================================
+/*!
+@brief	Set the combine window.
+An update waiting for the old window is sent at once.
+
+@return		None.
+@param	windowUS	Microseconds to combine updates over. 0 sends each
+					update at once. BACKLIGHT_COMBINE_UNTIL_FLUSH holds
+					updates until BacklightFlush.
+*/
+void BacklightSetCombineWindow(uint32_t windowUS)
+{
+	BacklightErrEnum	err;
+
+	pthread_mutex_lock(&gLock);
+
+	gCombineUS = windowUS;
+	if (gPending)
+	{
+		gPending = false;
+		err = BacklightSendLocked();
+		if (BacklightNoErr != err)
+			gFlushErr = err;
+	}
+
+	pthread_mutex_unlock(&gLock);
+}
+
+//======================================================================
+/*!
+@brief	Send packets to a function instead of the spi device.
+@details
+Lets the update path be timed or checked without the hardware. The hook
+gets the whole chain's packet and returns the number of bytes sent, or
+less than 1 on an error, like the transfer ioctl. The spi session is
+closed, and the first packet after a change of hook is always sent.
+
+@return		None.
+@param	hook	The function, or NULL to use the spi device again.
+@param	context	Passed to the hook.
+*/
+void BacklightSetTransferHook(BacklightTransferHook hook, void *context)
+{
+	pthread_mutex_lock(&gLock);
+
+	BacklightCloseLocked();
+	gTransferHook = hook;
+	gTransferContext = context;
+
+	pthread_mutex_unlock(&gLock);
+}
+
+//======================================================================
+/*!
+@brief	Return the combine window.
+
+@return		Combine window in microseconds.
+*/
+uint32_t BacklightGetCombineWindow(void)
+{
+	return gCombineUS;
+}
+
+//======================================================================
+/*!
+@brief	Return the number of packets sent to the chain.
+
+@return		Packets sent since the program started.
+*/
+uint32_t BacklightGetSentCount(void)
+{
+	uint32_t	count;
+
+	pthread_mutex_lock(&gLock);
+	count = gSentCount;
+	pthread_mutex_unlock(&gLock);
+	return count;
+}
+
+//======================================================================
+/*!
+@brief	Return the number of sends skipped because nothing changed.
+
+@return		Sends skipped since the program started.
+*/
+uint32_t BacklightGetSkippedCount(void)
+{
+	uint32_t	count;
+
+	pthread_mutex_lock(&gLock);
+	count = gSkippedCount;
+	pthread_mutex_unlock(&gLock);
+	return count;
+}
+
 //======================================================================
 /*!
 @brief	Return a string version of a backlight error.
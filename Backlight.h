@@ -20,6 +20,20 @@ is the resolution of the brightness vs. the grayscale values.
 It probly makes sense to hold one at its maximum value and 
 adjust the other.
 
+Larger enclosures chain BACKLIGHT_CHIPS controllers (see ProjectConfig.h)
+and use all 12 outputs of each. Every output is a channel with its own
+grayscale value, numbered R0, G0, B0, R1 ... B3 on the first chip and then
+on through the chain, so LED 1 and 2 above are channels 0 and 1. Each chip
+has its own red, green and blue brightness. The whole chain is sent as a
+single spi transfer.
+
+Updates can be write combined. By default (BACKLIGHT_COMBINE_US 0) each
+update is sent before it returns. With a combine window set, an update only
+marks the LEDs as changed, and the whole chain is sent once the window after
+the first one has passed, so any number of Set calls in that time cost one
+transfer. BacklightFlush sends at once. The last packet sent is kept, and an
+update that would send the same packet again sends nothing.
+
 @copyright (c) 2016, Bay Computer Associates.<br>
 All rights reserved.<br>
 This file contains CONFIDENTIAL material.<br>
@@ -55,6 +69,9 @@ BACKLIGHT_ERROR_(BacklightSpiModeErr	,"Can't set spi mode."		) \
 BACKLIGHT_ERROR_(BacklightSpiBitsErr	,"Can't set bits per word."	) \
 BACKLIGHT_ERROR_(BacklightSpiSpeedErr	,"Can't set max speed hz."	) \
 BACKLIGHT_ERROR_(BacklightSpiSendErr	,"Can't send spi message."	) \
+BACKLIGHT_ERROR_(BacklightAnimFullErr	,"Animation queue is full."	) \
+BACKLIGHT_ERROR_(BacklightAnimThreadErr	,"Can't start animator."	) \
+BACKLIGHT_ERROR_(BacklightRangeErr		,"Channel out of range."	) \
 //Comment terminates list macro. Do not delete.
 
 typedef enum
@@ -75,7 +92,33 @@ typedef enum
 typedef uint8_t BacklightBrightness;
 typedef uint16_t BacklightGrayscale;
 
-//Set LED functions.
+typedef enum
+{
+	BacklightRed,
+	BacklightGreen,
+	BacklightBlue,
+	BacklightColorCOUNT
+} BacklightColorEnum;
+
+//Shift register of one chip. The chain is BACKLIGHT_CHIPS of them, sent as
+//one packet of BACKLIGHT_PACKET_BYTES.
+#define SHIFT_REGISTER_LENGTH_BITS 224
+#define SHIFT_REGISTER_LENGTH_BYTES (SHIFT_REGISTER_LENGTH_BITS / 8)
+#define BACKLIGHT_PACKET_BYTES (SHIFT_REGISTER_LENGTH_BYTES * BACKLIGHT_CHIPS)
+
+#define BACKLIGHT_OUTPUTS_PER_CHIP 4
+#define BACKLIGHT_CHANNELS_PER_CHIP (BACKLIGHT_OUTPUTS_PER_CHIP * BacklightColorCOUNT)
+#define BACKLIGHT_CHANNELS (BACKLIGHT_CHIPS * BACKLIGHT_CHANNELS_PER_CHIP)
+
+//Channel number of one color of one output.
+#define BACKLIGHT_CHANNEL(chip, output, color) \
+	(((chip) * BACKLIGHT_OUTPUTS_PER_CHIP + (output)) * BacklightColorCOUNT + (color))
+#define BACKLIGHT_LED1_CHANNEL BACKLIGHT_CHANNEL(0, 0, BacklightRed)
+#define BACKLIGHT_LED2_CHANNEL BACKLIGHT_CHANNEL(0, 0, BacklightGreen)
+
+//Set LED functions. With update true these call BacklightUpdateLEDs. While
+//a combine window is set, that returns before the LEDs change, and an spi
+//error from the combined send is returned by the next update or flush.
 BacklightErrEnum SetBrightness(
 	BacklightBrightness led1, 
 	BacklightBrightness led2, 
@@ -85,13 +128,48 @@ BacklightErrEnum SetGrayscale(
 	BacklightGrayscale led2, 
 	bool update);
 
+//Set chain functions.
+BacklightErrEnum SetChipBrightness(
+	uint16_t chip,
+	BacklightBrightness red,
+	BacklightBrightness green,
+	BacklightBrightness blue,
+	bool update);
+BacklightErrEnum SetChannelGrayscale(
+	uint16_t first,
+	uint16_t count,
+	const BacklightGrayscale *grayscale,
+	bool update);
+
+//Replaces the spi device, to time or check the update path. Returns the
+//bytes sent, or less than 1 on an error.
+typedef int (*BacklightTransferHook)(const uint8_t *packet, uint32_t length, void *context);
+
+//Combine window that holds updates until BacklightFlush.
+#define BACKLIGHT_COMBINE_UNTIL_FLUSH UINT32_MAX
+
+//SPI session functions.
+BacklightErrEnum BacklightOpen(void);
+void BacklightClose(void);
+
+//With a nonzero combine window, BacklightUpdateLEDs only schedules the send
+//and reports errors from an earlier combined send. BacklightFlush sends any
+//waiting update and returns its result.
 BacklightErrEnum BacklightUpdateLEDs(void);
+BacklightErrEnum BacklightFlush(void);
+void BacklightSetCombineWindow(uint32_t windowUS);
+void BacklightSetTransferHook(BacklightTransferHook hook, void *context);
 
 //Access functions.
 BacklightBrightness	GetBrightness1(void);
 BacklightBrightness	GetBrightness2(void);
 BacklightGrayscale	GetGrayscale1(void);
 BacklightGrayscale	GetGrayscale2(void);
+BacklightBrightness	GetChipBrightness(uint16_t chip, BacklightColorEnum color);
+BacklightGrayscale	GetChannelGrayscale(uint16_t channel);
+uint32_t			BacklightGetCombineWindow(void);
+uint32_t			BacklightGetSentCount(void);
+uint32_t			BacklightGetSkippedCount(void);
 
 const char*			BacklightErrDesc(BacklightErrEnum err);
 
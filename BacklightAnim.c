@@ -0,0 +1,799 @@
+//======================================================================
+/*!
+@file BacklightAnim.c
+Implements the background backlight animator.
+
+@copyright (c) 2016, Bay Computer Associates.<br>
+All rights reserved.<br>
+This file contains CONFIDENTIAL material.<br>
+Bay Computer Associates and forbids duplication of
+this material with out express written permission
+from Bay Computer Associates.
+
+Repository URL:		$HeadURL:  $
+Last changed by:	$Author: $
+Last changed on:	$Date:  $
+Revision:			$Rev:  $
+*/
+
+//API implementation includes.
+#include <stdbool.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include "BacklightAnim.h"
+#include "lut_tables.h"
+#include "macros.h"
+
+
+//======================================================================
+//! Private types.
+typedef enum
+{
+	BacklightAnimFadeCmd,
+	BacklightAnimBlinkCmd,
+	BacklightAnimPulseCmd
+} BacklightAnimCmdEnum;
+
+typedef struct
+{
+	BacklightAnimId			id;
+	BacklightAnimCmdEnum	cmd;
+	BacklightLevel			from;		//Fade start, blink off, pulse low.
+	BacklightLevel			to;			//Fade end, blink on, pulse high.
+	uint32_t				durationMS;	//Fade duration, blink on time, pulse period.
+	uint32_t				offMS;		//Blink off time.
+	uint32_t				count;		//Blinks or pulses. 0 pulses forever.
+	BacklightEaseEnum		ease;		//Fade and pulse progress curve.
+	BacklightLightness		fromL;		//from and to as lightness, set when it starts.
+	BacklightLightness		toL;
+} BacklightAnimCommand;
+
+//======================================================================
+//! Private variables.
+//The lock guards everything below. The thread drops it while it writes
+// the backlight, so callers never wait on the spi bus.
+static pthread_mutex_t gLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t gWake;
+static pthread_t gThread;
+static bool gStarted = false;
+static bool gStop = false;
+
+static BacklightAnimCommand gQueue[BACKLIGHT_ANIM_QUEUE_DEPTH];
+static uint32_t gQueueHead = 0;
+static uint32_t gQueueCount = 0;
+
+static BacklightAnimCommand gRunning;
+static bool gHaveRunning = false;
+static struct timespec gStartTime;		//When the running command started.
+static struct timespec gChainTime;		//When the last command was due to end.
+static bool gChainValid = false;
+static uint32_t gGeneration = 0;		//Changes when the running command is dropped.
+
+static BacklightAnimId gNextId = 1;
+static BacklightErrEnum gLastErr = BacklightNoErr;
+
+static const char * easeNames[BacklightEaseCOUNT] = 
+{
+#define BACKLIGHT_EASE_(enumTag, name, lut) name,
+	BACKLIGHT_EASE_LIST
+#undef BACKLIGHT_EASE_
+};
+
+static const uint16_t * easeLuts[BacklightEaseCOUNT] = 
+{
+#define BACKLIGHT_EASE_(enumTag, name, lut) lut,
+	BACKLIGHT_EASE_LIST
+#undef BACKLIGHT_EASE_
+};
+
+//======================================================================
+//! Private prototypes.
+static void *BacklightAnimThread(void *arg);
+
+//======================================================================
+/*!
+@brief	Add milliseconds to an absolute time.
+
+@return		None.
+@param	t	The time to advance.
+@param	ms	Milliseconds to add.
+*/
+static void BacklightAnimAddMS(struct timespec *t, uint64_t ms)
+{
+	t->tv_sec += ms / MSECS_PER_SECOND;
+	t->tv_nsec += (ms % MSECS_PER_SECOND) * NSEC_PER_MSECS;
+	if (t->tv_nsec >= NSEC_PER_SECOND)
+	{
+		t->tv_sec++;
+		t->tv_nsec -= NSEC_PER_SECOND;
+	}
+}
+
+//======================================================================
+/*!
+@brief	Return the whole milliseconds from one time to a later one.
+
+@return		Milliseconds, or 0 if to is not after from.
+@param	from	The earlier time.
+@param	to		The later time.
+*/
+static uint64_t BacklightAnimElapsedMS(const struct timespec *from, const struct timespec *to)
+{
+	int64_t ns;
+
+	ns = (int64_t)(to->tv_sec - from->tv_sec) * NSEC_PER_SECOND + (to->tv_nsec - from->tv_nsec);
+	return (ns > 0) ? (uint64_t)ns / NSEC_PER_MSECS : 0;
+}
+
+//======================================================================
+/*!
+@brief	Return the output for a lightness.
+@details
+The output is the product of brightness and grayscale, so it is counted in
+units of 1/(BACKLIGHT_BRIGHTNESS_MAX * BACKLIGHT_GRAYSCALE_MAX) of full.
+The lightness table is interpolated with 8 fraction bits, which covers the
+extra range.
+
+@return		Output, 0 to BACKLIGHT_BRIGHTNESS_MAX * BACKLIGHT_GRAYSCALE_MAX.
+@param	lightness	The lightness.
+*/
+static uint32_t BacklightAnimOutput(BacklightLightness lightness)
+{
+	return ((uint64_t)lut_interp(lut_lightness, lightness) * BACKLIGHT_BRIGHTNESS_MAX + 128) >> 8;
+}
+
+//======================================================================
+/*!
+@brief	Turn a lightness into a brightness and grayscale pair.
+@details
+Uses the lowest brightness that can reach the output, so grayscale keeps
+as much of its 16-bit range as possible. Dim levels get a brightness of 1
+and steps 127 times finer than grayscale alone could make.
+
+@return		The level.
+@param	lightness	The lightness.
+*/
+BacklightLevel BacklightLightnessToLevel(BacklightLightness lightness)
+{
+	BacklightLevel	level;
+	uint32_t		output;
+	uint32_t		grayscale;
+
+	output = BacklightAnimOutput(lightness);
+	level.brightness = (output + BACKLIGHT_GRAYSCALE_MAX - 1) / BACKLIGHT_GRAYSCALE_MAX;
+	if (level.brightness == BACKLIGHT_BRIGHTNESS_MIN)
+	{
+		level.grayscale = BACKLIGHT_GRAYSCALE_MIN;
+		return level;
+	}
+	grayscale = (output + level.brightness / 2) / level.brightness;
+	level.grayscale = (grayscale > BACKLIGHT_GRAYSCALE_MAX) ? BACKLIGHT_GRAYSCALE_MAX : grayscale;
+	return level;
+}
+
+//======================================================================
+/*!
+@brief	Return the lightness of a brightness and grayscale pair.
+This searches the lightness table, so it is only used when a command starts.
+
+@return		The lowest lightness whose output reaches the level's output.
+@param	level	The level.
+*/
+BacklightLightness BacklightLevelToLightness(BacklightLevel level)
+{
+	uint32_t	output;
+	uint32_t	low;
+	uint32_t	high;
+	uint32_t	middle;
+
+	output = (uint32_t)level.brightness * level.grayscale;
+	low = BACKLIGHT_LIGHTNESS_MIN;
+	high = BACKLIGHT_LIGHTNESS_MAX;
+	while (low < high)
+	{
+		middle = (low + high) / 2;
+		if (BacklightAnimOutput(middle) < output)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+	return low;
+}
+
+//======================================================================
+/*!
+@brief	Interpolate in lightness along an easing curve.
+
+@return		The level at progress t/d from a to b.
+*/
+static BacklightLevel BacklightAnimLerp(const BacklightAnimCommand *command,
+	BacklightLightness a, BacklightLightness b, uint64_t t, uint64_t d)
+{
+	const uint16_t	*lut;
+	uint32_t		progress;
+
+	progress = (t * BACKLIGHT_LIGHTNESS_MAX) / d;
+	lut = easeLuts[command->ease];
+	if (lut != NULL)
+	{
+		progress = lut_interp(lut, progress) >> 8;
+	}
+	return BacklightLightnessToLevel(a + ((int64_t)(b - a) * progress) / BACKLIGHT_LIGHTNESS_MAX);
+}
+
+//======================================================================
+/*!
+@brief	Return how long a command runs.
+
+@return		Milliseconds, or 0 for a pulse that runs forever.
+*/
+static uint64_t BacklightAnimLengthMS(const BacklightAnimCommand *command)
+{
+	switch (command->cmd)
+	{
+	case BacklightAnimBlinkCmd:
+		return (uint64_t)command->count * (command->durationMS + command->offMS);
+	case BacklightAnimPulseCmd:
+		return (uint64_t)command->count * command->durationMS;
+	default:
+		return command->durationMS;
+	}
+}
+
+//======================================================================
+/*!
+@brief	Work out a command's level at a time since it started.
+@details
+Every level is computed from the time since the start, never from the
+previous step, so a late step catches up instead of slowing the animation.
+The next step is due at an absolute time as well: on the step grid for fades
+and pulses, or at the next on/off edge for a blink.
+
+@return		True when the command has finished and level is its final level.
+@param	command	The running command.
+@param	t		Milliseconds since the command started.
+@param	level	Returns the level to show now.
+@param	nextMS	Returns when the next step is due, in milliseconds since the start.
+*/
+static bool BacklightAnimStep(const BacklightAnimCommand *command, uint64_t t,
+	BacklightLevel *level, uint64_t *nextMS)
+{
+	uint64_t	length;
+	uint64_t	period;
+	uint64_t	phase;
+	uint64_t	half;
+
+	length = BacklightAnimLengthMS(command);
+	*nextMS = (t / BACKLIGHT_ANIM_STEP_MS + 1) * BACKLIGHT_ANIM_STEP_MS;
+
+	switch (command->cmd)
+	{
+	case BacklightAnimFadeCmd:
+	default:
+		if (t >= length)
+		{
+			*level = command->to;
+			return true;
+		}
+		*level = BacklightAnimLerp(command, command->fromL, command->toL, t, length);
+		break;
+
+	case BacklightAnimBlinkCmd:
+		//Each blink is off and then on.
+		if (t >= length)
+		{
+			*level = command->from;
+			return true;
+		}
+		period = command->durationMS + command->offMS;
+		phase = t % period;
+		if (phase < command->offMS)
+		{
+			*level = command->from;
+			*nextMS = t - phase + command->offMS;
+		}
+		else
+		{
+			*level = command->to;
+			*nextMS = t - phase + period;
+		}
+		return false;
+
+	case BacklightAnimPulseCmd:
+		if ((command->count > 0 && t >= length) || command->durationMS == 0)
+		{
+			*level = command->from;
+			return true;
+		}
+		period = command->durationMS;
+		phase = t % period;
+		half = period / 2;
+		if (phase < half)
+		{
+			*level = BacklightAnimLerp(command, command->fromL, command->toL, phase, half);
+		}
+		else
+		{
+			*level = BacklightAnimLerp(command, command->toL, command->fromL, phase - half, period - half);
+		}
+		break;
+	}
+
+	if (length > 0 && *nextMS > length)
+	{
+		*nextMS = length;
+	}
+	return false;
+}
+
+//======================================================================
+/*!
+@brief	Write a level to the backlight.
+Steps are already paced, so the level is flushed rather than left for
+the combine window. A step that doesn't change the level sends nothing.
+
+@return		BacklightNoErr | spi bus errors.
+*/
+static BacklightErrEnum BacklightAnimApply(BacklightLevel level)
+{
+	SetBrightness(level.brightness, BACKLIGHT_BRIGHTNESS_MIN, false);
+	SetGrayscale(level.grayscale, BACKLIGHT_GRAYSCALE_MIN, false);
+	return BacklightFlush();
+}
+
+//======================================================================
+/*!
+@brief	Make the next queued command the running one. Called with the lock held.
+@details
+A command that was queued before the previous one finished starts when
+that one was due to end, so a chain of commands does not drift. Otherwise
+it starts now. A fade starts from the level the backlight is at.
+
+@return		True if a command was started.
+*/
+static bool BacklightAnimStartNext(void)
+{
+	if (gQueueCount == 0)
+	{
+		return false;
+	}
+
+	gRunning = gQueue[gQueueHead];
+	gQueueHead = (gQueueHead + 1) % BACKLIGHT_ANIM_QUEUE_DEPTH;
+	gQueueCount--;
+	gHaveRunning = true;
+
+	if (gChainValid)
+	{
+		gStartTime = gChainTime;
+		gChainValid = false;
+	}
+	else
+	{
+		clock_gettime(CLOCK_MONOTONIC, &gStartTime);
+	}
+
+	if (BacklightAnimFadeCmd == gRunning.cmd)
+	{
+		gRunning.from.brightness = GetBrightness1();
+		gRunning.from.grayscale = GetGrayscale1();
+	}
+	if (BacklightAnimBlinkCmd != gRunning.cmd)
+	{
+		gRunning.fromL = BacklightLevelToLightness(gRunning.from);
+		gRunning.toL = BacklightLevelToLightness(gRunning.to);
+	}
+	return true;
+}
+
+//======================================================================
+/*!
+@brief	Drop the running command. Called with the lock held.
+The backlight stays at the last level written.
+
+@return		None.
+*/
+static void BacklightAnimDropRunning(void)
+{
+	if (gHaveRunning)
+	{
+		gHaveRunning = false;
+		gChainValid = false;
+		gGeneration++;
+	}
+}
+
+//======================================================================
+/*!
+@brief	The animator thread.
+@details
+Steps the running command and then sleeps until its next absolute
+deadline. Queuing, canceling or stopping wakes it early.
+
+@return		NULL.
+*/
+static void *BacklightAnimThread(void *arg)
+{
+	struct timespec		now;
+	struct timespec		deadline;
+	BacklightLevel		level;
+	BacklightErrEnum	err;
+	uint64_t			nextMS;
+	uint32_t			generation;
+	bool				finished;
+
+	(void)arg;
+
+	pthread_mutex_lock(&gLock);
+	while (!gStop)
+	{
+		if (!gHaveRunning && !BacklightAnimStartNext())
+		{
+			pthread_cond_wait(&gWake, &gLock);
+			continue;
+		}
+
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		finished = BacklightAnimStep(&gRunning, BacklightAnimElapsedMS(&gStartTime, &now),
+			&level, &nextMS);
+		generation = gGeneration;
+
+		pthread_mutex_unlock(&gLock);
+		err = BacklightAnimApply(level);
+		pthread_mutex_lock(&gLock);
+
+		if (BacklightNoErr != err)
+		{
+			gLastErr = err;
+		}
+		if (generation != gGeneration)
+		{
+			//Canceled or preempted while writing.
+			continue;
+		}
+
+		if (finished)
+		{
+			gHaveRunning = false;
+			if (gQueueCount > 0)
+			{
+				gChainTime = gStartTime;
+				BacklightAnimAddMS(&gChainTime, BacklightAnimLengthMS(&gRunning));
+				gChainValid = true;
+			}
+			continue;
+		}
+
+		deadline = gStartTime;
+		BacklightAnimAddMS(&deadline, nextMS);
+		while (!gStop && generation == gGeneration &&
+			pthread_cond_timedwait(&gWake, &gLock, &deadline) != ETIMEDOUT)
+		{
+		}
+	}
+	pthread_mutex_unlock(&gLock);
+	return NULL;
+}
+
+//======================================================================
+/*!
+@brief	Queue a command, starting the animator thread if needed.
+
+@return		BacklightNoErr | BacklightAnimFullErr | BacklightAnimThreadErr.
+@param	command	The command. Its id is filled in.
+@param	mode	Queue behind the other commands or preempt them.
+@param	id		Returns the command id. May be NULL.
+*/
+static BacklightErrEnum BacklightAnimSubmit(BacklightAnimCommand *command,
+	BacklightAnimMode mode, BacklightAnimId *id)
+{
+	pthread_condattr_t	attr;
+
+	pthread_mutex_lock(&gLock);
+
+	if (!gStarted)
+	{
+		//Deadlines are on the monotonic clock.
+		pthread_condattr_init(&attr);
+		pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+		pthread_cond_init(&gWake, &attr);
+		pthread_condattr_destroy(&attr);
+
+		gStop = false;
+		if (pthread_create(&gThread, NULL, BacklightAnimThread, NULL) != 0)
+		{
+			pthread_cond_destroy(&gWake);
+			pthread_mutex_unlock(&gLock);
+			return BacklightAnimThreadErr;
+		}
+		gStarted = true;
+	}
+
+	if (BacklightAnimPreempt == mode)
+	{
+		gQueueCount = 0;
+		BacklightAnimDropRunning();
+	}
+
+	if (gQueueCount == BACKLIGHT_ANIM_QUEUE_DEPTH)
+	{
+		pthread_mutex_unlock(&gLock);
+		return BacklightAnimFullErr;
+	}
+
+	command->id = gNextId++;
+	if (gNextId == 0)
+	{
+		gNextId = 1;
+	}
+	gQueue[(gQueueHead + gQueueCount) % BACKLIGHT_ANIM_QUEUE_DEPTH] = *command;
+	gQueueCount++;
+	if (id != NULL)
+	{
+		*id = command->id;
+	}
+
+	pthread_cond_signal(&gWake);
+	pthread_mutex_unlock(&gLock);
+	return BacklightNoErr;
+}
+
+//======================================================================
+/*!
+@brief	Fade to a level.
+The fade starts from whatever level the backlight is at when the command
+starts, and ends at the given level. It moves evenly in lightness, shaped
+by the easing curve.
+
+@return		BacklightNoErr | BacklightAnimFullErr | BacklightAnimThreadErr.
+@param	to			The final level.
+@param	durationMS	The length of the fade. 0 sets the level at once.
+@param	ease		The easing curve.
+@param	mode		Queue behind the other commands or preempt them.
+@param	id			Returns the command id. May be NULL.
+*/
+BacklightErrEnum BacklightAnimFade(
+	BacklightLevel to,
+	uint32_t durationMS,
+	BacklightEaseEnum ease,
+	BacklightAnimMode mode,
+	BacklightAnimId *id)
+{
+	BacklightAnimCommand command = {0};
+
+	command.cmd = BacklightAnimFadeCmd;
+	command.to = to;
+	command.durationMS = durationMS;
+	command.ease = (ease < BacklightEaseCOUNT) ? ease : BacklightEaseLinear;
+	return BacklightAnimSubmit(&command, mode, id);
+}
+
+//======================================================================
+/*!
+@brief	Blink some number of times.
+Each blink is off (brightness 0 at the on grayscale) for offMS and then on
+for onMS. The backlight is left off.
+
+@return		BacklightNoErr | BacklightAnimFullErr | BacklightAnimThreadErr.
+@param	on		The on level.
+@param	onMS	The on part of each blink in milliseconds.
+@param	offMS	The off part of each blink in milliseconds.
+@param	count	The number of blinks.
+@param	mode	Queue behind the other commands or preempt them.
+@param	id		Returns the command id. May be NULL.
+*/
+BacklightErrEnum BacklightAnimBlink(
+	BacklightLevel on,
+	uint32_t onMS,
+	uint32_t offMS,
+	uint32_t count,
+	BacklightAnimMode mode,
+	BacklightAnimId *id)
+{
+	BacklightAnimCommand command = {0};
+
+	command.cmd = BacklightAnimBlinkCmd;
+	command.from.brightness = BACKLIGHT_BRIGHTNESS_MIN;
+	command.from.grayscale = on.grayscale;
+	command.to = on;
+	command.durationMS = onMS;
+	command.offMS = offMS;
+	command.count = (onMS + offMS > 0) ? count : 0;
+	return BacklightAnimSubmit(&command, mode, id);
+}
+
+//======================================================================
+/*!
+@brief	Pulse between two levels.
+Each pulse goes from low to high in the first half of the period and back
+to low in the second. The backlight is left at low. A pulse with a count
+of 0 runs until it is canceled or preempted.
+
+@return		BacklightNoErr | BacklightAnimFullErr | BacklightAnimThreadErr.
+@param	low			The level at the start and end of each pulse.
+@param	high		The level at the middle of each pulse.
+@param	periodMS	The length of each pulse in milliseconds.
+@param	count		The number of pulses, or 0 for forever.
+@param	ease		The easing curve for each half of a pulse.
+@param	mode		Queue behind the other commands or preempt them.
+@param	id			Returns the command id. May be NULL.
+*/
+BacklightErrEnum BacklightAnimPulse(
+	BacklightLevel low,
+	BacklightLevel high,
+	uint32_t periodMS,
+	uint32_t count,
+	BacklightEaseEnum ease,
+	BacklightAnimMode mode,
+	BacklightAnimId *id)
+{
+	BacklightAnimCommand command = {0};
+
+	command.cmd = BacklightAnimPulseCmd;
+	command.from = low;
+	command.to = high;
+	command.durationMS = periodMS;
+	command.count = count;
+	command.ease = (ease < BacklightEaseCOUNT) ? ease : BacklightEaseLinear;
+	return BacklightAnimSubmit(&command, mode, id);
+}
+
+//======================================================================
+/*!
+@brief	Cancel a running or queued command.
+A running command stops where it is and the next queued command starts.
+
+@return		True if the command was found.
+@param	id	The command id.
+*/
+bool BacklightAnimCancel(BacklightAnimId id)
+{
+	uint32_t	i;
+	bool		found;
+
+	found = false;
+	pthread_mutex_lock(&gLock);
+
+	if (gHaveRunning && gRunning.id == id)
+	{
+		BacklightAnimDropRunning();
+		found = true;
+	}
+
+	for (i = 0; i < gQueueCount && !found; i++)
+	{
+		if (gQueue[(gQueueHead + i) % BACKLIGHT_ANIM_QUEUE_DEPTH].id == id)
+		{
+			//Close the gap.
+			for (; i + 1 < gQueueCount; i++)
+			{
+				gQueue[(gQueueHead + i) % BACKLIGHT_ANIM_QUEUE_DEPTH] =
+					gQueue[(gQueueHead + i + 1) % BACKLIGHT_ANIM_QUEUE_DEPTH];
+			}
+			gQueueCount--;
+			found = true;
+		}
+	}
+
+	if (found && gStarted)
+	{
+		pthread_cond_signal(&gWake);
+	}
+	pthread_mutex_unlock(&gLock);
+	return found;
+}
+
+//======================================================================
+/*!
+@brief	Cancel the running command and everything queued.
+The backlight stays at its current level.
+
+@return		None.
+*/
+void BacklightAnimCancelAll(void)
+{
+	pthread_mutex_lock(&gLock);
+	gQueueCount = 0;
+	BacklightAnimDropRunning();
+	if (gStarted)
+	{
+		pthread_cond_signal(&gWake);
+	}
+	pthread_mutex_unlock(&gLock);
+}
+
+//======================================================================
+/*!
+@brief	Cancel everything and stop the animator thread.
+The next command starts the thread again.
+
+@return		None.
+*/
+void BacklightAnimStop(void)
+{
+	pthread_mutex_lock(&gLock);
+	if (!gStarted)
+	{
+		pthread_mutex_unlock(&gLock);
+		return;
+	}
+	gQueueCount = 0;
+	BacklightAnimDropRunning();
+	gStop = true;
+	pthread_cond_signal(&gWake);
+	pthread_mutex_unlock(&gLock);
+
+	pthread_join(gThread, NULL);
+
+	pthread_mutex_lock(&gLock);
+	pthread_cond_destroy(&gWake);
+	gStarted = false;
+	gStop = false;
+	pthread_mutex_unlock(&gLock);
+}
+
+//======================================================================
+/*!
+@brief	Return the id of the running command.
+
+@return		The command id, or 0 if none is running.
+*/
+BacklightAnimId BacklightAnimCurrent(void)
+{
+	BacklightAnimId id;
+
+	pthread_mutex_lock(&gLock);
+	id = gHaveRunning ? gRunning.id : 0;
+	pthread_mutex_unlock(&gLock);
+	return id;
+}
+
+//======================================================================
+/*!
+@brief	Return whether a command is running or queued.
+
+@return		True until the last command finishes.
+*/
+bool BacklightAnimBusy(void)
+{
+	bool busy;
+
+	pthread_mutex_lock(&gLock);
+	busy = gHaveRunning || gQueueCount > 0;
+	pthread_mutex_unlock(&gLock);
+	return busy;
+}
+
+//======================================================================
+/*!
+@brief	Return the last error from writing the backlight, and clear it.
+
+@return		BacklightNoErr | spi bus errors.
+*/
+BacklightErrEnum BacklightAnimLastErr(void)
+{
+	BacklightErrEnum err;
+
+	pthread_mutex_lock(&gLock);
+	err = gLastErr;
+	gLastErr = BacklightNoErr;
+	pthread_mutex_unlock(&gLock);
+	return err;
+}
+
+//======================================================================
+/*!
+@brief	Return the name of an easing curve.
+
+@return		The name, as listed in BACKLIGHT_EASE_LIST, or "unknown" if out of range.
+@param	ease	The easing curve.
+*/
+const char* BacklightEaseName(BacklightEaseEnum ease)
+{
+	if ((unsigned)ease >= BacklightEaseCOUNT)
+	{
+		return "unknown";
+	}
+	return easeNames[ease];
+}
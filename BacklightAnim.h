@@ -0,0 +1,135 @@
+/*!
+@file BacklightAnim.h
+API for animating the backlight LED panels in the background.
+An animator thread owns the backlight while it runs. Callers queue
+commands (fade, blink, pulse) that the thread plays one after another,
+so none of these functions block for the length of an animation.
+
+Each command is timed from the absolute time it starts, and the thread
+sleeps until the next absolute deadline rather than for a fixed delay, so
+the time spent sending updates never stretches an animation. A command
+queued behind another starts at the exact time the previous one ends.
+
+Fades and pulses move in perceived lightness (CIE L*), not in raw
+grayscale, so equal steps in time look like equal steps in brightness.
+The progress through each one can follow an easing curve. Lightness is
+turned into output through lookup tables with no floating point per step.
+The output drives the 7-bit brightness and 16-bit grayscale together,
+using the lowest brightness that can reach it. That leaves the full
+grayscale range for the dim end, where the eye is most sensitive, and
+gives about 127 times finer steps there than grayscale alone.
+
+A command can be queued behind the ones already waiting, or it can
+preempt them. Preempting cancels the running command and everything
+queued, and the new command starts from whatever level the backlight
+has reached. Any command can also be canceled by its id, which leaves
+the backlight at its current level.
+
+While the animator has commands, it sets the backlight on every step,
+so SetBrightness and SetGrayscale calls from other threads are
+overwritten.
+
+@copyright (c) 2016, Bay Computer Associates.<br>
+All rights reserved.<br>
+This file contains CONFIDENTIAL material.<br>
+Bay Computer Associates and forbids duplication of
+this material with out express written permission
+from Bay Computer Associates.
+
+Repository URL:		$HeadURL: $
+Last changed by:	$Author: $
+Last changed on:	$Date:  $
+Revision:			$Rev:  $
+*/
+
+#ifndef _BACKLIGHT_ANIM_H
+#define _BACKLIGHT_ANIM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "Backlight.h"
+
+//Time between steps of a fade or pulse.
+#define BACKLIGHT_ANIM_STEP_MS 17
+
+//Commands that can wait behind the running one.
+#define BACKLIGHT_ANIM_QUEUE_DEPTH 16
+
+//A brightness and grayscale pair. The actual output is the product of the two.
+typedef struct
+{
+	BacklightBrightness	brightness;
+	BacklightGrayscale	grayscale;
+} BacklightLevel;
+
+//Perceived lightness, CIE L* 0-100 scaled to 0-65535.
+typedef uint16_t BacklightLightness;
+#define BACKLIGHT_LIGHTNESS_MIN 0
+#define BACKLIGHT_LIGHTNESS_MAX 0xFFFF
+
+//BACKLIGHT_EASE_(enumTag, name, lut)
+#define BACKLIGHT_EASE_LIST \
+BACKLIGHT_EASE_(BacklightEaseLinear	,"linear"	,NULL				) \
+BACKLIGHT_EASE_(BacklightEaseIn		,"in"		,lut_ease_in		) \
+BACKLIGHT_EASE_(BacklightEaseOut	,"out"		,lut_ease_out		) \
+BACKLIGHT_EASE_(BacklightEaseInOut	,"inOut"	,lut_ease_in_out	) \
+BACKLIGHT_EASE_(BacklightEaseSine	,"sine"		,lut_ease_sine		) \
+//Comment terminates list macro. Do not delete.
+
+typedef enum
+{
+#define BACKLIGHT_EASE_(enumTag, name, lut) enumTag,
+	BACKLIGHT_EASE_LIST
+#undef BACKLIGHT_EASE_
+	BacklightEaseCOUNT
+} BacklightEaseEnum;
+
+typedef enum
+{
+	BacklightAnimQueue,		//Start after the commands already queued.
+	BacklightAnimPreempt	//Cancel everything and start now.
+} BacklightAnimMode;
+
+//Identifies a queued command. Never 0.
+typedef uint32_t BacklightAnimId;
+
+//Command functions. Each returns immediately. id may be NULL.
+BacklightErrEnum BacklightAnimFade(
+	BacklightLevel to,
+	uint32_t durationMS,
+	BacklightEaseEnum ease,
+	BacklightAnimMode mode,
+	BacklightAnimId *id);
+BacklightErrEnum BacklightAnimBlink(
+	BacklightLevel on,
+	uint32_t onMS,
+	uint32_t offMS,
+	uint32_t count,
+	BacklightAnimMode mode,
+	BacklightAnimId *id);
+BacklightErrEnum BacklightAnimPulse(
+	BacklightLevel low,
+	BacklightLevel high,
+	uint32_t periodMS,
+	uint32_t count,
+	BacklightEaseEnum ease,
+	BacklightAnimMode mode,
+	BacklightAnimId *id);
+
+//Control functions.
+bool BacklightAnimCancel(BacklightAnimId id);
+void BacklightAnimCancelAll(void);
+void BacklightAnimStop(void);
+
+//Access functions.
+BacklightAnimId		BacklightAnimCurrent(void);
+bool				BacklightAnimBusy(void);
+BacklightErrEnum	BacklightAnimLastErr(void);
+const char*			BacklightEaseName(BacklightEaseEnum ease);
+
+//Lightness conversions.
+BacklightLevel		BacklightLightnessToLevel(BacklightLightness lightness);
+BacklightLightness	BacklightLevelToLightness(BacklightLevel level);
+
+#endif
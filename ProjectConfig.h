@@ -34,6 +34,25 @@ Revision:		$Rev: $
 //======================================================================
 //Build switches.
 
+//LED strip chipset and color order. One of the tags in DOTSTAR_CHIPSET_LIST
+//in dotstar_chipset.h.
+#ifndef DOTSTAR_CHIPSET
+#define DOTSTAR_CHIPSET	APA102_BGR
+#endif
+
+//Number of TLC59711 backlight controllers daisy-chained on the backlight
+//spi bus.
+#ifndef BACKLIGHT_CHIPS
+#define BACKLIGHT_CHIPS	1
+#endif
+
+//Backlight updates requested within this many microseconds of the first
+//are combined into one spi transfer. 0 sends every update at once, and is
+//the default so Set calls with update true stay synchronous. 2000 suits
+//callers that update faster than the spi bus.
+#ifndef BACKLIGHT_COMBINE_US
+#define BACKLIGHT_COMBINE_US	0
+#endif
 
 //======================================================================
 //Basic type information for the project.
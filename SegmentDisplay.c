@@ -24,9 +24,11 @@ Revision:			$Rev:  $
 //======================================================================
 //! API implementation includes.
 #include <fcntl.h>
+#include <linux/i2c.h>
 #include <linux/i2c-dev.h>
 #include <sys/ioctl.h>
 #include <unistd.h>
+#include <string.h>
 #include <linux/types.h>
 #include "SegmentDisplay.h"
 #include "STREAM_macros.h"
@@ -44,7 +46,16 @@ Revision:			$Rev:  $
 #define HT16K33_CMD_OSC_ON		0x21
 #define HT16K33_CMD_BRIGHTNESS	0xE0
 #define HT16K33_CMD_BLINK		0x80
-#define HT16K33_CMD_WRITE		0x00
+#define HT16K33_CMD_WRITE		0x00	//ORed with the RAM address to write from.
+
+//A changed run of display bytes goes out as its own message with its RAM
+//address. Runs this many unchanged bytes apart or closer are sent as one,
+//since a new message costs about as much as the bytes it skips.
+#define SEGDISP_MERGE_GAP 2
+
+//Most messages one display update can need: every other byte changed on
+//both controllers, before merging.
+#define SEGDISP_MAX_MSGS (2 * SEGDISP_NUM_CHARS)
 
 //The specific decimal point segment bit within SegDispBitmask.
 #define SEGDISP_DP_BITPOS 14
@@ -71,6 +82,9 @@ Revision:			$Rev:  $
 //ioctl device driver.
 static const char *device = "/dev/i2c-2";
 
+//i2c session. The device stays open between writes.
+static int gFd = -1;
+
 //Create commands for each blink parameter value. The commands look like this:
 // cccccrre, where c is the blink command code, r is the rate and e is an enable bit.
 // If the enable bit is 0 then the display of off. If the enable bit is 1 and the rate
@@ -98,6 +112,16 @@ static const char * segDispErrDescs[SegDispErrCOUNT] =
 static uint8_t displayBuffer0[1 + (SEGDISP_NUM_CHARS * sizeof(SegDispBitmask))];
 static uint8_t displayBuffer1[1 + (SEGDISP_NUM_CHARS * sizeof(SegDispBitmask))];
 
+//What the controllers last received, in the same layout. Only valid while
+//the session stays open, since another program may write the display
+//while it is closed.
+static uint8_t shadowBuffer0[sizeof(displayBuffer0)];
+static uint8_t shadowBuffer1[sizeof(displayBuffer1)];
+static bool gShadowValid = false;
+
+//Bytes put on the bus, counting each message's slave address.
+static uint32_t gBytesSent = 0;
+
 //This is a table of character segment bitmasks indexed by ASCII code.
 static const SegDispBitmask alphafonttable[] = 
 {
@@ -234,7 +258,12 @@ static const SegDispBitmask alphafonttable[] =
 //======================================================================
 //! Private prototypes.
 SegDispErrEnum SegDispWriteByte(uint8_t byte, bool led1, bool led2);
-SegDispErrEnum SegDispWriteBuffer(uint8_t i2cAddr, uint8_t * buffer, SegDispDisplayOffset bufferSize);
+SegDispErrEnum SegDispWriteBuffers(
+	uint8_t * buffer0, SegDispDisplayOffset bufferSize0,
+	uint8_t * buffer1, SegDispDisplayOffset bufferSize1);
+SegDispErrEnum SegDispTransfer(struct i2c_msg * msgs, int count);
+static int SegDispDiffBuffer(uint8_t i2cAddr, const uint8_t * buffer, 
+	const uint8_t * shadow, struct i2c_msg * msgs, uint8_t * scratch);
 
 
 //======================================================================
@@ -248,7 +277,9 @@ set one brightness level without affecting the other LED.
 NOTE that a level of 0 is not off. To turn off the display without 
 erasing the text, use the SegDispBlink function.
 
-@return		SegDispNoErr | SegDispWriteByte() errors.
+Both levels go out in one i2c transaction.
+
+@return		SegDispNoErr | SegDispWriteBuffers() errors.
 @param	brightness1	Brightness level (0-15) for LED1.
 @param	brightness2	Brightness level (0-15) for LED2.
 
@@ -259,21 +290,12 @@ SegDispErrEnum	SegDispSetBrightness(
 									 SegDispBrightness brightness1, 
 									 SegDispBrightness brightness2)
 {
-	uint8_t			byte;
-	SegDispErrEnum	err = SegDispNoErr;
+	uint8_t			byte1 = HT16K33_CMD_BRIGHTNESS | brightness1;
+	uint8_t			byte2 = HT16K33_CMD_BRIGHTNESS | brightness2;
 
-	if (brightness1 <= SEGDISP_BRIGHTNESS_MAX)
-	{
-		err = SegDispWriteByte(HT16K33_CMD_BRIGHTNESS | brightness1, true, false);
-	}
-	if (SegDispNoErr == err)
-	{
-		if (brightness2 <= SEGDISP_BRIGHTNESS_MAX)
-		{
-			err = SegDispWriteByte(HT16K33_CMD_BRIGHTNESS | brightness2, false, true);
-		}
-	}
-	return err;
+	return SegDispWriteBuffers(
+		&byte1, (brightness1 <= SEGDISP_BRIGHTNESS_MAX) ? 1 : 0,
+		&byte2, (brightness2 <= SEGDISP_BRIGHTNESS_MAX) ? 1 : 0);
 }
 
 //======================================================================
@@ -445,24 +467,38 @@ The segment bitmasks in the display buffer are sent to the LEDs via
 the i2c bus. Call this after setting the contents of the display buffer(s)
 to show the display on the LEDs.
 
-@return		SegDispNoErr | errors from SegDispWriteBuffer.
+Only the bytes that differ from what the controllers last received are
+sent. Each changed run goes out with its RAM address, and the runs for
+both controllers go out in one i2c transaction. If nothing changed the
+bus is not used at all.
+
+@return		SegDispNoErr | errors from SegDispTransfer.
 
 @author	John Heaney
 @test	12/07/2016 Unit Test: UNTESTED
 */
 SegDispErrEnum SegDispUpdate(void)
 {
-	SegDispErrEnum	err = SegDispNoErr;
+	struct i2c_msg	msgs[SEGDISP_MAX_MSGS];
+	uint8_t			scratch[2][2 * sizeof(displayBuffer0)];
+	int				count;
+	SegDispErrEnum	err;
 
 	displayBuffer0[0] = HT16K33_CMD_WRITE;
-	err = SegDispWriteBuffer(SEGDISP_I2CADDR0, displayBuffer0, sizeof(displayBuffer0));
+	displayBuffer1[0] = HT16K33_CMD_WRITE;
+
+	count = SegDispDiffBuffer(SEGDISP_I2CADDR0, displayBuffer0, shadowBuffer0, msgs, scratch[0]);
+	count += SegDispDiffBuffer(SEGDISP_I2CADDR1, displayBuffer1, shadowBuffer1, &msgs[count], scratch[1]);
+	if (0 == count)
+		return SegDispNoErr;
 
+	err = SegDispTransfer(msgs, count);
 	if (SegDispNoErr == err)
 	{
-		displayBuffer1[0] = HT16K33_CMD_WRITE;
-		err = SegDispWriteBuffer(SEGDISP_I2CADDR1, displayBuffer1, sizeof(displayBuffer1));
+		memcpy(shadowBuffer0, displayBuffer0, sizeof(shadowBuffer0));
+		memcpy(shadowBuffer1, displayBuffer1, sizeof(shadowBuffer1));
+		gShadowValid = true;
 	}
-
 	return err;
 }
 
@@ -475,7 +511,7 @@ Set the display to on and not blinking. Set the brightness
 to maximum. Nothing will be displayed, so any initial configuration
 can be accomplished after this call.
 
-@return		SegDispNoErr | errors from SegDispWriteBuffer.
+@return		SegDispNoErr | errors from SegDispWriteBuffers.
 
 @author	John Heaney
 @test	12/07/2016 Unit Test: UNTESTED
@@ -484,6 +520,8 @@ SegDispErrEnum SegDispInit()
 {
 	SegDispErrEnum	err = SegDispNoErr;
 
+	//The display may have been reset, so send all of it.
+	gShadowValid = false;
 	SegDispClear();
 	err = SegDispUpdate();
 	if (SegDispNoErr != err)
@@ -498,9 +536,7 @@ SegDispErrEnum SegDispInit()
 		return err;
 
 	err = SegDispSetBrightness(SEGDISP_BRIGHTNESS_MAX, SEGDISP_BRIGHTNESS_MAX);
-	if (SegDispNoErr != err)
-		return err;
-
+	return err;
 }
 
 //======================================================================
@@ -530,7 +566,9 @@ SegDispNO_BLINK and SegDispDISP_OFF for both LEDs. Turning the display
 on and off this way does not affect the text being displayed or the
 brightness of the LEDs.
 
-@return		SegDispNoErr | errors from SegDispWriteBuffer.
+Both settings go out in one i2c transaction.
+
+@return		SegDispNoErr | errors from SegDispWriteBuffers.
 @param	rate1 Blink parameter for LED1.
 @param	rate2 Blink parameter for LED2.
 
@@ -541,83 +579,224 @@ SegDispErrEnum SegDispBlink(
 							SegDispBlinkEnum rate1, 
 							SegDispBlinkEnum rate2)
 {
-	SegDispErrEnum	err = SegDispNoErr;
-	uint8_t			rate;
+	uint8_t			byte1 = (rate1 < SegDispBlinkCOUNT) ? segDispBlinkCmds[rate1] : 0;
+	uint8_t			byte2 = (rate2 < SegDispBlinkCOUNT) ? segDispBlinkCmds[rate2] : 0;
 
-	rate = rate1;
-	if (rate < SegDispBlinkCOUNT)
-	{
-		err = SegDispWriteByte(segDispBlinkCmds[rate], true, false);
-	}
-	if (SegDispNoErr == err)
+	return SegDispWriteBuffers(
+		&byte1, (rate1 < SegDispBlinkCOUNT) ? 1 : 0,
+		&byte2, (rate2 < SegDispBlinkCOUNT) ? 1 : 0);
+}
+
+//======================================================================
+/*!
+@brief	Open the display i2c session.
+@details
+The i2c device stays open until SegDispClose(), so each write after this
+is a single ioctl. Opening a session that is already open does nothing.
+The write functions open the session themselves if needed, so calling
+this first is optional.
+
+@return		SegDispNoErr | SegDispOpenErr.
+*/
+SegDispErrEnum SegDispOpen(void)
+{
+	if (gFd >= 0)
+		return SegDispNoErr;
+
+	gFd = open(device, O_RDWR);
+	if (gFd < 0)
+		return SegDispOpenErr;
+
+	return SegDispNoErr;
+}
+
+//======================================================================
+/*!
+@brief	Close the display i2c session.
+@details
+The LEDs keep showing what they were last sent, but the next session sends
+the whole display on its first update. Closing a session that is not open
+does nothing.
+
+@return		None.
+*/
+void SegDispClose(void)
+{
+	if (gFd >= 0)
 	{
-		rate = rate2;
-		if (rate < SegDispBlinkCOUNT)
-		{
-			err = SegDispWriteByte(segDispBlinkCmds[rate], false, true);
-		}
+		close(gFd);
+		gFd = -1;
 	}
-
-	return err;
+	gShadowValid = false;
 }
 
 //======================================================================
 /*!
-@brief	Write the contents of a byte buffer over i2c bus.
+@brief	Write byte buffers to the two LED controllers over the i2c bus.
 @details
-There are two i2c busses; one per LED. An ID is passed into this function
-to address the specific device. The linux ioctl device control api is
-used to communicate.
+There are two controllers on the i2c bus; one per LED. Each buffer goes
+to one of them as its own message, and the messages are sent together
+by SegDispTransfer(), so writing both LEDs is one system call.
+A buffer with a size of 0 is skipped, which allows writing to one LED.
 
 There are a number of possible errors associated with using ioctl. Each
 error has an associated text description, which is available via the 
 SegDispErrDesc() function.
 
-@return		SegDispNoErr | errors related to ioctl.
-@param	i2cAddr Address of the target i2c bus.
-@param	buffer Pointer to byte buffer to transmit.
-@param	bufferSize Number of bytes in buffer to send.
-
-@author	John Heaney
-@test	12/07/2016 Unit Test: UNTESTED
+@return		SegDispNoErr | errors from SegDispTransfer().
+@param	buffer0 Pointer to byte buffer to transmit to LED1.
+@param	bufferSize0 Number of bytes in buffer0 to send.
+@param	buffer1 Pointer to byte buffer to transmit to LED2.
+@param	bufferSize1 Number of bytes in buffer1 to send.
 */
-SegDispErrEnum SegDispWriteBuffer(
-								  uint8_t i2cAddr, 
-								  uint8_t * buffer, 
-								  SegDispDisplayOffset bufferSize)
+SegDispErrEnum SegDispWriteBuffers(
+								   uint8_t * buffer0, 
+								   SegDispDisplayOffset bufferSize0,
+								   uint8_t * buffer1, 
+								   SegDispDisplayOffset bufferSize1)
 {
-	int				fd;
-	int				ret;
-	SegDispErrEnum	result;
-
-	result = SegDispNoErr;
+	struct i2c_msg	msgs[2];
+	int				count = 0;
 
-	fd = open(device, O_RDWR);
-	if (fd < 0)
+	if (bufferSize0 > 0)
 	{
-		result = SegDispOpenErr;
+		msgs[count++] = (struct i2c_msg)
+		{
+			.addr = SEGDISP_I2CADDR0,
+			.flags = 0,
+			.len = bufferSize0,
+			.buf = buffer0,
+		};
 	}
-	else
+	if (bufferSize1 > 0)
 	{
-		//Acquire i2c bus.
-		ret = ioctl(fd, I2C_SLAVE, i2cAddr);
-		if (ret == -1)
+		msgs[count++] = (struct i2c_msg)
 		{
-			result = SegDispAcquireI2CErr;
-		}
-		else
+			.addr = SEGDISP_I2CADDR1,
+			.flags = 0,
+			.len = bufferSize1,
+			.buf = buffer1,
+		};
+	}
+	return SegDispTransfer(msgs, count);
+}
+
+//======================================================================
+/*!
+@brief	Send i2c messages in one transaction.
+@details
+The messages are sent together with a single I2C_RDWR ioctl, opening
+the session first if it is not open. If the write fails the session is
+closed, so the next write opens the device again.
+
+@return		SegDispNoErr | errors related to ioctl.
+@param	msgs Messages to send.
+@param	count Number of messages. Nothing is sent if 0.
+*/
+SegDispErrEnum SegDispTransfer(
+							   struct i2c_msg * msgs, 
+							   int count)
+{
+	struct i2c_rdwr_ioctl_data	transaction;
+	int							ret;
+	int							i;
+	SegDispErrEnum				result;
+
+	if (0 == count)
+		return SegDispNoErr;
+
+	result = SegDispOpen();
+	if (SegDispNoErr != result)
+		return result;
+
+	//Send the bytes.
+	transaction.msgs = msgs;
+	transaction.nmsgs = count;
+	ret = ioctl(gFd, I2C_RDWR, &transaction);
+	if (ret != count)
+	{
+		SegDispClose();
+		return SegDispWriteI2CErr;
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		gBytesSent += 1 + msgs[i].len;
+	}
+	return result;
+}
+
+//======================================================================
+/*!
+@brief	Build messages for the bytes of one display buffer that changed.
+@details
+Compares the buffer to the shadow of what its controller last received
+and makes one message per changed run of bytes. Each message starts with
+the RAM address of its first byte, so the controller writes the run in
+place. Runs no more than SEGDISP_MERGE_GAP bytes apart are joined. If
+the shadow is not valid the whole buffer is one message.
+
+@return		Number of messages made, 0 if nothing changed.
+@param	i2cAddr Address of the controller.
+@param	buffer Display buffer, write command first.
+@param	shadow Shadow of the same controller.
+@param	msgs Receives the messages.
+@param	scratch Holds the message bytes. Twice the size of the buffer.
+*/
+static int SegDispDiffBuffer(
+							 uint8_t i2cAddr, 
+							 const uint8_t * buffer, 
+							 const uint8_t * shadow, 
+							 struct i2c_msg * msgs, 
+							 uint8_t * scratch)
+{
+	const uint8_t *	data = buffer + 1;
+	const int		size = sizeof(displayBuffer0) - 1;
+	int				count = 0;
+	int				start;
+	int				end;
+	int				i;
+
+	for (i = 0; i < size; i++)
+	{
+		if (gShadowValid && (data[i] == shadow[1 + i]))
+			continue;
+
+		//Extend the run while the next change is close enough.
+		start = i;
+		end = i;
+		for (i = start + 1; (i < size) && (i - end <= SEGDISP_MERGE_GAP + 1); i++)
 		{
-			//Send the bytes.
-			ret = write(fd, buffer, bufferSize);
-			if (ret == -1)
-			{
-				result = SegDispWriteI2CErr;
-			}
+			if (!gShadowValid || (data[i] != shadow[1 + i]))
+				end = i;
 		}
+		i = end;
 
-		close(fd);
+		scratch[0] = HT16K33_CMD_WRITE | start;
+		memcpy(&scratch[1], &data[start], end - start + 1);
+		msgs[count++] = (struct i2c_msg)
+		{
+			.addr = i2cAddr,
+			.flags = 0,
+			.len = end - start + 2,
+			.buf = scratch,
+		};
+		scratch += end - start + 2;
 	}
-	return result;
+	return count;
+}
+
+//======================================================================
+/*!
+@brief	Return the number of bytes put on the i2c bus.
+@details
+Each message counts its slave address byte as well as its data.
+
+@return		Bytes sent since the program started.
+*/
+uint32_t SegDispGetBytesSent(void)
+{
+	return gBytesSent;
 }
 
 //======================================================================
@@ -630,7 +809,7 @@ than pass in the desired i2c address, there is a boolean for each
 i2c bus that determines if the byte should be written to the
 corresponding bus.
 
-@return		SegDispNoErr | errors from SegDispWriteBuffer().
+@return		SegDispNoErr | errors from SegDispWriteBuffers().
 @param	byte Byte to send (typically, a command).
 @param	led1 Set to true to send command to LED1.
 @param	led2 Set to true to send command to LED2.
@@ -643,18 +822,7 @@ SegDispErrEnum SegDispWriteByte(
 								bool led1, 
 								bool led2)
 {
-	SegDispErrEnum	err = SegDispNoErr;
-
-	if (led1)
-	{
-		err = SegDispWriteBuffer(SEGDISP_I2CADDR0, &byte, 1);
-	}
-
-	if ((SegDispNoErr == err) && led2)
-	{
-		err = SegDispWriteBuffer(SEGDISP_I2CADDR1, &byte, 1);
-	}
-	return err;
+	return SegDispWriteBuffers(&byte, led1 ? 1 : 0, &byte, led2 ? 1 : 0);
 }
 
 //======================================================================
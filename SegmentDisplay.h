@@ -129,6 +129,11 @@ SegDispErrEnum	SegDispUpdate(void);
 SegDispErrEnum	SegDispSetBrightness(SegDispBrightness brightness1, SegDispBrightness brightness2);
 SegDispErrEnum	SegDispBlink(SegDispBlinkEnum rate1, SegDispBlinkEnum rate2);
 
+//i2c session functions.
+SegDispErrEnum	SegDispOpen(void);
+void			SegDispClose(void);
+uint32_t		SegDispGetBytesSent(void);
+
 const char*		SegDispErrDesc(SegDispErrEnum err);
 
 #endif
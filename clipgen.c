@@ -0,0 +1,217 @@
+/*!
+ *	@file		clipgen.c
+ *	@author		BCA
+ *	@version	1.0.0
+ *	@date		12/2/16
+ *	@brief		Build-host encoder for Dotstar animation clips
+ *	@copyright	 Bay Computer Associates, Incorporated 2016
+				All rights reserved
+				This file contains CONFIDENTIAL material
+ *	@remark		Matilda USPS Blue Box
+ *	@Repository URL: $HeadURL: $
+ *	Last changed by: $Author: $
+ *	Last changed on: $Date: $
+ *	Revision:		$Rev: $
+**/
+
+// Runs on the build host and encodes raw frames into the clip format in
+// dotstar_clip.h. Build it with make clipgen.
+//
+//     ./clipgen numLEDs fps keyInterval out.clip < frames.raw
+//
+// frames.raw holds the frames back to back, each numLEDs dotstar_rgbb
+// (red, green, blue, brightness). Every keyInterval frames a key frame is
+// written so the player can seek, and any frame whose delta would be larger
+// than a key frame is written as one.
+
+#include "dotstar_clip.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// A run header costs as much as 2 pixels, so a span of changed pixels only
+// ends after this many unchanged ones, and a fill run needs this many equal
+// pixels.
+#define CLIPGEN_MIN_RUN 3
+#define CLIPGEN_MAX_RUN 0xFFFF
+
+static int same(const dotstar_rgbb * a, const dotstar_rgbb * b)
+{
+    return memcmp(a, b, sizeof(dotstar_rgbb)) == 0;
+}
+
+static uint8_t * emit(uint8_t * out, uint32_t offset, uint32_t count, uint16_t type,
+                      const dotstar_rgbb * pixels, uint32_t * runs)
+{
+    dotstar_clip_run run = { offset, (uint16_t) count, type };
+    uint32_t n = (type == DOTSTAR_CLIP_RUN_COPY) ? count : 1;
+
+    memcpy(out, &run, sizeof(run));
+    memcpy(out + sizeof(run), pixels, n * sizeof(dotstar_rgbb));
+    (*runs)++;
+    return out + sizeof(run) + n * sizeof(dotstar_rgbb);
+}
+
+// Encode the pixels of cur that differ from base as runs. Returns the bytes
+// written to out.
+static uint32_t encode(uint8_t * out, const dotstar_rgbb * base, const dotstar_rgbb * cur,
+                       uint32_t num_leds, uint32_t * runs)
+{
+    uint8_t *ptr = out;
+    uint32_t i = 0;
+
+    *runs = 0;
+    while (i < num_leds) {
+        if (same(&base[i], &cur[i])) {
+            i++;
+            continue;
+        }
+
+        // Find the end of the span of changed pixels.
+        uint32_t end = i + 1;
+        for (uint32_t gap = 0, j = end; j < num_leds && gap < CLIPGEN_MIN_RUN; j++) {
+            if (same(&base[j], &cur[j])) {
+                gap++;
+            } else {
+                gap = 0;
+                end = j + 1;
+            }
+        }
+
+        // Split the span into fill runs of equal pixels and copy runs of the
+        // rest.
+        uint32_t copy = i;
+        while (i < end) {
+            uint32_t equal = i + 1;
+            while (equal < end && equal - i < CLIPGEN_MAX_RUN && same(&cur[equal], &cur[i])) {
+                equal++;
+            }
+            if (equal - i >= CLIPGEN_MIN_RUN || i - copy == CLIPGEN_MAX_RUN) {
+                if (i > copy) {
+                    ptr = emit(ptr, copy, i - copy, DOTSTAR_CLIP_RUN_COPY, &cur[copy], runs);
+                }
+                if (equal - i >= CLIPGEN_MIN_RUN) {
+                    ptr = emit(ptr, i, equal - i, DOTSTAR_CLIP_RUN_FILL, &cur[i], runs);
+                    i = equal;
+                }
+                copy = i;
+            } else {
+                i++;
+            }
+        }
+        if (i > copy) {
+            ptr = emit(ptr, copy, i - copy, DOTSTAR_CLIP_RUN_COPY, &cur[copy], runs);
+        }
+    }
+    return ptr - out;
+}
+
+static int write_frame(FILE * out, uint16_t type, uint32_t runs, const uint8_t * data, uint32_t size)
+{
+    dotstar_clip_frame frame = { type, (uint16_t) runs, size };
+
+    return fwrite(&frame, sizeof(frame), 1, out) == 1 &&
+           fwrite(data, 1, size, out) == size;
+}
+
+int main(int argc, const char * argv[])
+{
+    if (argc != 5) {
+        fprintf(stderr, "usage: clipgen numLEDs fps keyInterval out.clip < frames.raw\n");
+        return 1;
+    }
+
+    uint32_t num_leds = strtoul(argv[1], NULL, 0);
+    uint32_t fps = strtoul(argv[2], NULL, 0);
+    uint32_t interval = strtoul(argv[3], NULL, 0);
+    if (num_leds == 0 || fps == 0 || interval == 0) {
+        fprintf(stderr, "numLEDs, fps and keyInterval must be > 0\n");
+        return 1;
+    }
+
+    FILE *out = fopen(argv[4], "wb");
+    if (out == NULL) {
+        perror(argv[4]);
+        return 1;
+    }
+
+    // Worst case is a run per pixel.
+    uint32_t max_size = num_leds * (sizeof(dotstar_clip_run) + sizeof(dotstar_rgbb));
+    dotstar_rgbb *black = (dotstar_rgbb *) calloc(num_leds, sizeof(dotstar_rgbb));
+    dotstar_rgbb *prev = (dotstar_rgbb *) calloc(num_leds, sizeof(dotstar_rgbb));
+    dotstar_rgbb *cur = (dotstar_rgbb *) calloc(num_leds, sizeof(dotstar_rgbb));
+    uint8_t *key = (uint8_t *) malloc(max_size);
+    uint8_t *delta = (uint8_t *) malloc(max_size);
+    uint32_t *index = NULL;
+    uint32_t num_frames = 0;
+    uint32_t num_keys = 0;
+    dotstar_clip_header header;
+
+    if (black == NULL || prev == NULL || cur == NULL || key == NULL || delta == NULL) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    memset(&header, 0, sizeof(header));
+    fwrite(&header, sizeof(header), 1, out);
+
+    while (fread(cur, sizeof(dotstar_rgbb), num_leds, stdin) == num_leds) {
+        uint32_t key_runs, delta_runs;
+        uint32_t key_size = encode(key, black, cur, num_leds, &key_runs);
+        int ok;
+
+        index = (uint32_t *) realloc(index, (num_frames + 1) * sizeof(uint32_t));
+        if (index == NULL) {
+            fprintf(stderr, "out of memory\n");
+            return 1;
+        }
+        index[num_frames] = ftell(out);
+
+        if (num_frames % interval == 0) {
+            ok = write_frame(out, DOTSTAR_CLIP_KEY, key_runs, key, key_size);
+            num_keys++;
+        } else {
+            uint32_t delta_size = encode(delta, prev, cur, num_leds, &delta_runs);
+            if (delta_size <= key_size) {
+                ok = write_frame(out, DOTSTAR_CLIP_DELTA, delta_runs, delta, delta_size);
+            } else {
+                ok = write_frame(out, DOTSTAR_CLIP_KEY, key_runs, key, key_size);
+                num_keys++;
+            }
+        }
+        if (!ok) {
+            perror(argv[4]);
+            return 1;
+        }
+
+        dotstar_rgbb *t = prev;
+        prev = cur;
+        cur = t;
+        num_frames++;
+    }
+
+    if (num_frames == 0) {
+        fprintf(stderr, "no frames on stdin\n");
+        return 1;
+    }
+
+    header.magic = DOTSTAR_CLIP_MAGIC;
+    header.version = DOTSTAR_CLIP_VERSION;
+    header.header_size = sizeof(header);
+    header.num_leds = num_leds;
+    header.num_frames = num_frames;
+    header.fps = fps;
+    header.index_offset = ftell(out);
+
+    if (fwrite(index, sizeof(uint32_t), num_frames, out) != num_frames ||
+        fseek(out, 0, SEEK_SET) != 0 ||
+        fwrite(&header, sizeof(header), 1, out) != 1 ||
+        fclose(out) != 0) {
+        perror(argv[4]);
+        return 1;
+    }
+
+    fprintf(stderr, "%u frames, %u key frames, %u bytes\n",
+            num_frames, num_keys, header.index_offset + num_frames * 4);
+    return 0;
+}
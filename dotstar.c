@@ -15,296 +15,1222 @@
 **/
 
 #include "dotstar.h"
+#include "dotstar_chipset.h"
+#include "dotstar_kernels.h"
+#include "lut_tables.h"
 #include <stdio.h>
 #include <stdlib.h> // for malloc
 #include <string.h> // for memset
 #include <unistd.h> // for close
 #include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
 #include <sys/mman.h>
 #include <sys/ioctl.h>
 #include <linux/spi/spidev.h>
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// One queue slot. seq tells whose turn the cell is: it is twice the enqueue
+// position when the cell is free and one more once it holds a frame. The
+// factor of two keeps the states apart when the queue is one cell deep.
+typedef struct {
+    uint32_t seq;
+    uint32_t frame;
+} dotstar_queue_cell;
+
+// Power of two that holds every frame index.
+#define DOTSTAR_FREE_LIST_SIZE (2 * DOTSTAR_QUEUE_MAX_DEPTH)
+
+struct dotstar {
+    // The strip is stored as a ring. Pixel 0 lives at pixels[head], so
+    // rotating or pushing only moves head and never the pixel data. The
+    // pixels are the middle of a wire frame, see dotstar_frame_alloc().
+    uint32_t *pixels;
+    uint32_t numLEDs;
+    uint32_t head;
+    int fd;
+
+    uint32_t footer_len;
+
+    // Transfer template. dotstar_write() copies it into the message so the
+    // writer thread and dotstar_h_show() never share a transfer array.
+    struct spi_ioc_transfer xfer;
+
+    // Largest message spidev accepts, in bytes.
+    uint32_t bufsiz;
 
-static uint32_t *pixels = NULL;
-static uint32_t numLEDs = 0;
-static int fd;
+    // Frame pipeline. With a curve or dithering enabled, dotstar_h_show()
+    // renders the pixels into an output frame instead of sending them as is.
+    // The render picks the smallest global brightness that can reach the
+    // brightest channel so dim pixels keep the full 8-bit range, and
+    // dithering carries the part below one 8-bit step over to the next frame.
+    dotstar_curve curve;
+    int dither_enabled;
+    uint8_t *dither_error;
+    uint32_t *out_frame;
 
-static const uint8_t header_data[4] = {
-    0x00, 0x00, 0x00, 0x00
+    // Planar mode. The planes share one allocation, see dotstar_planes.
+    uint8_t *plane_data;
+    dotstar_planes planes;
+
+    // Asynchronous output. dotstar_h_show() renders into the fill frame and
+    // hands its index to the writer thread through a bounded queue. The
+    // queue is a ring of sequence-numbered cells, so the handoff needs no
+    // lock. The producer can also take the oldest frame back out to make
+    // room, which is why a dequeue claims its cell with a CAS. The writer
+    // returns finished frames through the free list. Every frame belongs to
+    // exactly one of the producer, the queue, the writer or the free list,
+    // so queue_depth + 2 frames are enough. The semaphores only wake the
+    // threads and never guard data.
+    int async_enabled;
+    pthread_t writer_thread;
+    dotstar_queue_policy queue_policy;
+    uint32_t queue_depth;
+    uint32_t *frames[DOTSTAR_QUEUE_MAX_DEPTH + 2];
+    dotstar_queue_cell cells[DOTSTAR_QUEUE_MAX_DEPTH];
+    uint32_t enqueue_pos;
+    uint32_t dequeue_pos;
+    uint32_t fill;
+    uint32_t free_list[DOTSTAR_FREE_LIST_SIZE];
+    uint32_t free_head;
+    uint32_t free_tail;
+    uint32_t queued;            // Frames queued or being written
+    int writer_stop;
+    sem_t wake;                 // A frame was queued or the writer must stop
+    sem_t space;                // The writer took a frame from the queue
+    sem_t idle;                 // The writer finished a frame
+    uint32_t frames_dropped;
+
+    // Set by every change to the pixels or the render settings. A frame
+    // that is not dirty is already on the strip and dotstar_h_show() skips
+    // it, unless dithering is on and every frame differs.
+    int dirty;
+    uint32_t frames_sent;
+    uint32_t frames_skipped;
 };
 
-static uint8_t * footer_data;
-
-static struct spi_ioc_transfer xfer[3] = {
-    { .tx_buf        = 0, // Header
-      .rx_buf        = 0,
-      .len           = 4,
-      .delay_usecs   = 0,
-      .bits_per_word = 8,
-      .cs_change     = 0 },
-    { .rx_buf        = 0, // Color payload
-      .delay_usecs   = 0,
-      .bits_per_word = 8,
-      .cs_change     = 0 },
-    { .tx_buf        = 0, // Footer
-      .rx_buf        = 0,
-      .len           = 4,
-      .delay_usecs   = 0,
-      .bits_per_word = 8,
-      .cs_change     = 0 }
+// A wire frame is one allocation laid out as header|pixels|footer, so an
+// unrotated frame goes out as a single transfer. The 4-byte header ends on a
+// cache line boundary, which keeps the pixels aligned for the kernels.
+#define DOTSTAR_FRAME_ALIGN 64
+#define DOTSTAR_HEADER_LEN 4
+
+static const struct spi_ioc_transfer xfer_template = {
+    .rx_buf        = 0,
+    .delay_usecs   = 0,
+    .bits_per_word = 8,
+    .cs_change     = 0
 };
 
-int dotstar_create(const char * device,
-                   uint32_t frequency,
-                   uint32_t num_leds)
+// spidev rejects a message whose transfers add up to more than its bufsiz
+// module parameter, which defaults to 4096 bytes.
+#define DOTSTAR_SPIDEV_BUFSIZ_PATH "/sys/module/spidev/parameters/bufsiz"
+#define DOTSTAR_SPIDEV_BUFSIZ_DEFAULT 4096
+
+// 8.8 channel value per unit of 16-bit intensity for each global brightness,
+// scaled by 2^16. Shared by every strip.
+static uint32_t brightness_scale[PIXEL_MAX_BRIGHTNESS + 1];
+static pthread_once_t brightness_scale_once = PTHREAD_ONCE_INIT;
+
+// The strip used by the functions without a handle. Until dotstar_create()
+// succeeds it is an empty strip, so those functions do nothing.
+static dotstar_t no_strip;
+static dotstar_t *default_strip = &no_strip;
+
+static void dotstar_init_brightness_scale(void)
+{
+    for (uint32_t i = 1; i <= PIXEL_MAX_BRIGHTNESS; i++) {
+        uint64_t scale = (uint64_t)PIXEL_MAX_BRIGHTNESS * 0xFF00 * 65536;
+        brightness_scale[i] = (uint32_t)((scale + 65535 * i / 2) / (65535 * i));
+    }
+}
+
+// Map a pixel index to its slot in the ring.
+static inline uint32_t dotstar_slot(const dotstar_t * strip, uint32_t p)
+{
+    uint32_t i = strip->head + p;
+    return (i >= strip->numLEDs) ? i - strip->numLEDs : i;
+}
+
+// Read the spidev message size limit.
+static uint32_t dotstar_spidev_bufsiz()
+{
+    unsigned int bufsiz = 0;
+    FILE *f = fopen(DOTSTAR_SPIDEV_BUFSIZ_PATH, "r");
+
+    if (f != NULL) {
+        if (fscanf(f, "%u", &bufsiz) != 1) {
+            bufsiz = 0;
+        }
+        fclose(f);
+    }
+    // Keep whole pixels in each message.
+    bufsiz &= ~3u;
+    return (bufsiz >= 4) ? bufsiz : DOTSTAR_SPIDEV_BUFSIZ_DEFAULT;
+}
+
+// Each LED passes the data on half a clock late, so the last LED needs
+// numLEDs/2 more clock edges after its pixel. The footer is the chipset's
+// reset frame, if any, followed by the fewest whole bytes that provide them.
+static uint32_t dotstar_footer_len(uint32_t num_leds)
+{
+    uint32_t bits = (num_leds + 1) / 2;
+    return DOTSTAR_RESET_BYTES + (bits + 7) / 8;
+}
+
+static uint32_t dotstar_frame_size(const dotstar_t * strip)
+{
+    uint32_t size = DOTSTAR_FRAME_ALIGN + strip->numLEDs * 4 + strip->footer_len;
+    return (size + DOTSTAR_FRAME_ALIGN - 1) & ~(uint32_t)(DOTSTAR_FRAME_ALIGN - 1);
+}
+
+// Allocate a wire frame and return its pixels, all off. The header and
+// footer are filled in once here and never written again.
+static uint32_t * dotstar_frame_alloc(const dotstar_t * strip)
+{
+    uint32_t size = dotstar_frame_size(strip);
+    void *data;
+
+    if (posix_memalign(&data, DOTSTAR_FRAME_ALIGN, size) != 0) {
+        return NULL;
+    }
+
+    uint8_t *pixels = (uint8_t*)data + DOTSTAR_FRAME_ALIGN;
+    uint8_t *footer = pixels + strip->numLEDs * 4;
+    // Set first byte of each 4-byte pixel to 0xFF, rest to 0x00 (off)
+    memset(data, 0x00, DOTSTAR_FRAME_ALIGN + strip->numLEDs * 4);
+    for (uint32_t i = 0; i < strip->numLEDs; i++) {
+        pixels[i * 4] = 0xFF;
+    }
+
+    // Datasheet says 32*1 bits for footer, but testing shows we must use
+    // at least (numLEDs + 1)/2 high values.
+    memset(footer, 0x00, DOTSTAR_RESET_BYTES);
+    memset(footer + DOTSTAR_RESET_BYTES, DOTSTAR_FOOTER_BYTE,
+           strip->footer_len - DOTSTAR_RESET_BYTES);
+
+    // Keep the frame resident so sending it never waits on a page fault.
+    // Without CAP_IPC_LOCK or enough RLIMIT_MEMLOCK it simply stays pageable.
+    mlock(data, size);
+    return (uint32_t*)pixels;
+}
+
+static void dotstar_frame_free(const dotstar_t * strip, uint32_t * pixels)
+{
+    if (pixels == NULL) {
+        return;
+    }
+
+    void *data = (uint8_t*)pixels - DOTSTAR_FRAME_ALIGN;
+    munlock(data, dotstar_frame_size(strip));
+    free(data);
+}
+
+// Send a wire frame whose first pixel is frame[start]. An unrotated frame is
+// one contiguous segment. A wrapped ring goes out as the header, two payload
+// segments and the footer, so nothing is moved. The segments are split into
+// messages of at most bufsiz bytes. The strip has no chip select, so the gap
+// between messages only pauses the clock.
+static void dotstar_write(dotstar_t * strip, const uint32_t * frame, uint32_t start)
+{
+    const uint8_t *wire = (const uint8_t*)frame;
+    const struct {
+        const uint8_t *data;
+        uint32_t len;
+    } part[4] = {
+        { wire - DOTSTAR_HEADER_LEN, DOTSTAR_HEADER_LEN },
+        { wire + start * 4, (strip->numLEDs - start) * 4 },
+        { wire, start * 4 },
+        { wire + strip->numLEDs * 4, strip->footer_len }
+    };
+    struct {
+        const uint8_t *data;
+        uint32_t len;
+    } segment[4];
+    int segments = 0;
+
+    // Join the parts that follow each other in memory.
+    for (int s = 0; s < 4; s++) {
+        if (part[s].len == 0) {
+            continue;
+        }
+        if (segments > 0 &&
+            segment[segments - 1].data + segment[segments - 1].len == part[s].data) {
+            segment[segments - 1].len += part[s].len;
+        } else {
+            segment[segments].data = part[s].data;
+            segment[segments++].len = part[s].len;
+        }
+    }
+
+    // A message covers a contiguous run of the segments, so it never needs
+    // more than one transfer per segment.
+    struct spi_ioc_transfer msg[4];
+    int count = 0;
+    uint32_t room = strip->bufsiz;
+
+    for (int s = 0; s < segments; s++) {
+        const uint8_t *data = segment[s].data;
+        uint32_t len = segment[s].len;
+
+        while (len > 0) {
+            uint32_t n = (len < room) ? len : room;
+
+            msg[count] = strip->xfer;
+            msg[count].tx_buf = (unsigned long)data;
+            msg[count++].len = n;
+            data += n;
+            len -= n;
+            room -= n;
+
+            if (room == 0 || count == 4) {
+                int ret = ioctl(strip->fd, SPI_IOC_MESSAGE(count), msg);
+                if (ret < 1) {
+                    printf("Can't send spi message.\n");
+                    return;
+                }
+                count = 0;
+                room = strip->bufsiz;
+            }
+        }
+    }
+
+    if (count > 0) {
+        int ret = ioctl(strip->fd, SPI_IOC_MESSAGE(count), msg);
+        if (ret < 1) {
+            printf("Can't send spi message.\n");
+        }
+    }
+}
+
+static void dotstar_render(dotstar_t * strip, uint32_t * frame)
+{
+    const uint16_t *lut = NULL;
+    uint8_t *out = (uint8_t*)frame;
+    uint8_t *error = strip->dither_error;
+
+    if (strip->curve == DOTSTAR_CURVE_GAMMA) {
+        lut = lut_gamma;
+    } else if (strip->curve == DOTSTAR_CURVE_CIE) {
+        lut = lut_cie;
+    }
+
+    for (uint32_t p = 0; p < strip->numLEDs; p++, out += 4, error += 3) {
+        const uint8_t *in = (const uint8_t*)&strip->pixels[dotstar_slot(strip, p)];
+        uint32_t level = in[0] & 0x1F;
+        uint32_t target[3];
+        uint32_t max = 0;
+
+        if (level > PIXEL_MAX_BRIGHTNESS) {
+            level = PIXEL_MAX_BRIGHTNESS;
+        }
+
+        // Blue, green, red intensity relative to full white at maximum
+        // brightness, 0-65535.
+        for (int c = 0; c < 3; c++) {
+            uint32_t linear = lut ? lut[in[c + 1]] : in[c + 1] * 257u;
+            target[c] = linear * level / PIXEL_MAX_BRIGHTNESS;
+            if (target[c] > max) {
+                max = target[c];
+            }
+        }
+
+        uint32_t brightness = (max * PIXEL_MAX_BRIGHTNESS + 65534) / 65535;
+        if (brightness == 0) {
+            brightness = 1;
+        }
+        out[0] = brightness | DOTSTAR_START_BITS;
+
+        for (int c = 0; c < 3; c++) {
+            uint32_t value = (uint32_t)(((uint64_t)target[c] * brightness_scale[brightness]) >> 16);
+            if (value > 0xFF00) {
+                value = 0xFF00;
+            }
+            if (strip->dither_enabled) {
+                value += error[c];
+                error[c] = value & 0xFF;
+                out[c + 1] = value >> 8;
+            } else {
+                out[c + 1] = (value + 0x80) >> 8;
+            }
+        }
+    }
+}
+
+// Queue a frame. Only the producer calls this.
+static int dotstar_queue_enqueue(dotstar_t * strip, uint32_t frame)
+{
+    uint32_t pos = strip->enqueue_pos;
+    dotstar_queue_cell *cell = &strip->cells[pos & (strip->queue_depth - 1)];
+
+    if (__atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE) != 2 * pos) {
+        return 0;
+    }
+    cell->frame = frame;
+    __atomic_store_n(&cell->seq, 2 * pos + 1, __ATOMIC_RELEASE);
+    strip->enqueue_pos = pos + 1;
+    return 1;
+}
+
+// Take the oldest frame. Called by the writer thread and by the producer
+// when it drops the oldest frame.
+static int dotstar_queue_dequeue(dotstar_t * strip, uint32_t * frame)
+{
+    uint32_t pos = __atomic_load_n(&strip->dequeue_pos, __ATOMIC_RELAXED);
+
+    while (1) {
+        dotstar_queue_cell *cell = &strip->cells[pos & (strip->queue_depth - 1)];
+        int32_t diff = (int32_t)(__atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE) - (2 * pos + 1));
+
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&strip->dequeue_pos, &pos, pos + 1, 0,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                *frame = cell->frame;
+                __atomic_store_n(&cell->seq, 2 * (pos + strip->queue_depth), __ATOMIC_RELEASE);
+                return 1;
+            }
+        } else if (diff < 0) {
+            return 0;
+        } else {
+            pos = __atomic_load_n(&strip->dequeue_pos, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+// Return a written frame to the producer. Only the writer thread calls this.
+static void dotstar_free_push(dotstar_t * strip, uint32_t frame)
+{
+    uint32_t head = strip->free_head;
+
+    strip->free_list[head & (DOTSTAR_FREE_LIST_SIZE - 1)] = frame;
+    __atomic_store_n(&strip->free_head, head + 1, __ATOMIC_RELEASE);
+}
+
+// Take a free frame. Only the producer calls this, right after it queued its
+// fill frame, and then at least one frame is free or about to be.
+static uint32_t dotstar_free_pop(dotstar_t * strip)
+{
+    uint32_t tail = strip->free_tail;
+
+    while (tail == __atomic_load_n(&strip->free_head, __ATOMIC_ACQUIRE)) {
+        sched_yield();
+    }
+    strip->free_tail = tail + 1;
+    return strip->free_list[tail & (DOTSTAR_FREE_LIST_SIZE - 1)];
+}
+
+// Hand the fill frame to the writer thread, applying the queue policy when
+// the queue is full. Returns 0 if the fill frame itself was dropped.
+static int dotstar_queue_push(dotstar_t * strip)
+{
+    int have_spare = 0;
+    uint32_t spare = 0;
+
+    __atomic_add_fetch(&strip->queued, 1, __ATOMIC_RELAXED);
+    while (!dotstar_queue_enqueue(strip, strip->fill)) {
+        if (have_spare) {
+            // The writer claimed the cell and is about to release it.
+            sched_yield();
+            continue;
+        }
+        switch (strip->queue_policy) {
+        case DOTSTAR_QUEUE_DROP_NEWEST:
+            __atomic_add_fetch(&strip->frames_dropped, 1, __ATOMIC_RELAXED);
+            __atomic_sub_fetch(&strip->queued, 1, __ATOMIC_RELEASE);
+            return 0;
+        case DOTSTAR_QUEUE_DROP_OLDEST:
+            if (dotstar_queue_dequeue(strip, &spare)) {
+                have_spare = 1;
+                __atomic_add_fetch(&strip->frames_dropped, 1, __ATOMIC_RELAXED);
+                __atomic_sub_fetch(&strip->queued, 1, __ATOMIC_RELEASE);
+            } else {
+                // The writer took the oldest frame first and is about to
+                // release its cell.
+                sched_yield();
+            }
+            break;
+        case DOTSTAR_QUEUE_BLOCK:
+            sem_wait(&strip->space);
+            break;
+        }
+    }
+    sem_post(&strip->wake);
+
+    strip->fill = have_spare ? spare : dotstar_free_pop(strip);
+    return 1;
+}
+
+static void * dotstar_writer(void * arg)
+{
+    dotstar_t *strip = (dotstar_t *) arg;
+    uint32_t frame;
+
+    while (1) {
+        if (dotstar_queue_dequeue(strip, &frame)) {
+            sem_post(&strip->space);
+            dotstar_write(strip, strip->frames[frame], 0);
+            dotstar_free_push(strip, frame);
+            __atomic_sub_fetch(&strip->queued, 1, __ATOMIC_RELEASE);
+            sem_post(&strip->idle);
+            continue;
+        }
+        // Queued frames are still written when stopping.
+        if (__atomic_load_n(&strip->writer_stop, __ATOMIC_ACQUIRE)) {
+            break;
+        }
+        sem_wait(&strip->wake);
+    }
+    return NULL;
+}
+
+dotstar_t * dotstar_h_open(const char * device,
+                           uint32_t frequency,
+                           uint32_t num_leds)
 {
     int ret = 0;
-    
+
     if (num_leds == 0) {
         printf("Enter a value > 0 for the number of LEDs.\n");
-        return -1;
+        return NULL;
     }
 
-    fd = open(device, O_RDWR);
+    int fd = open(device, O_RDWR);
 	if (fd < 0) {
 		printf("Can't open device. Try sudo.\n");
-        return -1;
+        return NULL;
     }
 
     uint8_t mode = 0;
 	ret = ioctl(fd, SPI_IOC_WR_MODE, &mode);
 	if (ret == -1) {
 		printf("Can't set spi mode.\n");
-        return -1;
+        close(fd);
+        return NULL;
     }
 
     uint8_t bits = 8;
 	ret = ioctl(fd, SPI_IOC_WR_BITS_PER_WORD, &bits);
 	if (ret == -1) {
 		printf("Can't set bits per word.\n");
-        return -1;
+        close(fd);
+        return NULL;
     }
-    
+
 	ret = ioctl(fd, SPI_IOC_WR_MAX_SPEED_HZ, &frequency);
 	if (ret == -1) {
 		printf("Can't set max speed HZ.\n");
-        return -1;
+        close(fd);
+        return NULL;
     }
-    
-    numLEDs = num_leds;
-    xfer[0].speed_hz = frequency;
-    xfer[1].speed_hz = frequency;
-    xfer[2].speed_hz = frequency;
-    xfer[1].len = numLEDs * 4;
-    xfer[2].len = (numLEDs + 15)/16;
-        
-    pixels = (uint32_t *) calloc(numLEDs, 4);
 
-	// Set first byte of each 4-byte pixel to 0xFF, rest to 0x00 (off)
-    for (uint32_t i = 0; i < numLEDs; i++)
-    {
-        pixels[i * 4] = 0xFF;
+    pthread_once(&brightness_scale_once, dotstar_init_brightness_scale);
+
+    dotstar_t *strip = (dotstar_t *) calloc(1, sizeof(dotstar_t));
+    if (strip == NULL) {
+        close(fd);
+        return NULL;
     }
 
-    // Datasheet says 32*1 bits for footer, but testing shows we must use
-    // at least (numLEDs + 1)/2 high values.
-    footer_data = (uint8_t *) malloc(xfer[2].len);
+    strip->fd = fd;
+    strip->numLEDs = num_leds;
+    strip->head = 0;
+    strip->xfer = xfer_template;
+    strip->xfer.speed_hz = frequency;
+    strip->bufsiz = dotstar_spidev_bufsiz();
+    strip->footer_len = dotstar_footer_len(strip->numLEDs);
+    strip->dirty = 1;
+    strip->queue_depth = 1;
+    strip->queue_policy = DOTSTAR_QUEUE_DROP_OLDEST;
 
-    memset(footer_data, 0xFF, xfer[2].len);
-    
-	return 0;
+    strip->pixels = dotstar_frame_alloc(strip);
+    strip->out_frame = dotstar_frame_alloc(strip);
+    strip->dither_error = (uint8_t *) calloc(strip->numLEDs, 3);
+
+    if (strip->pixels == NULL || strip->out_frame == NULL || strip->dither_error == NULL) {
+        dotstar_h_close(strip);
+        return NULL;
+    }
+
+	return strip;
 }
 
-void dotstar_destroy()
+void dotstar_h_close(dotstar_t * strip)
 {
-	if (fd) {
-		close(fd);
-		fd = -1;
+    if (strip == NULL || strip == &no_strip) {
+        return;
+    }
+
+    dotstar_h_set_async(strip, 0);
+
+	if (strip->fd >= 0) {
+		close(strip->fd);
 	}
-    
-	if (pixels) {
-        free(pixels);
+
+    dotstar_frame_free(strip, strip->pixels);
+    dotstar_frame_free(strip, strip->out_frame);
+    free(strip->dither_error);
+    free(strip->plane_data);
+    free(strip);
+}
+
+void dotstar_h_clear(dotstar_t * strip)
+{
+    // Ignore brightness
+    dotstar_kernels->scale(strip->pixels, strip->pixels, strip->numLEDs, 0, 0, 0);
+    strip->dirty = 1;
+}
+
+void dotstar_h_show(dotstar_t * strip)
+{
+    if (strip->numLEDs == 0) {
+        return;
     }
 
-    if (footer_data) {
-        free(footer_data);
+    if (!strip->dirty && !strip->dither_enabled) {
+        strip->frames_skipped++;
+        return;
+    }
+    strip->dirty = 0;
+
+    if (strip->plane_data) {
+        dotstar_kernels->pack(strip->pixels, &strip->planes, strip->numLEDs);
+        strip->head = 0;
+    }
+
+    int render = (strip->curve != DOTSTAR_CURVE_LINEAR) || strip->dither_enabled;
+
+    if (!strip->async_enabled) {
+        if (render) {
+            dotstar_render(strip, strip->out_frame);
+            dotstar_write(strip, strip->out_frame, 0);
+        } else {
+            dotstar_write(strip, strip->pixels, strip->head);
+        }
+        strip->frames_sent++;
+        return;
+    }
+
+    // The queued frame is stored unwrapped.
+    uint32_t *frame = strip->frames[strip->fill];
+    if (render) {
+        dotstar_render(strip, frame);
+    } else {
+        uint32_t first = strip->numLEDs - strip->head;
+        memcpy(frame, &strip->pixels[strip->head], first * 4);
+        memcpy(&frame[first], strip->pixels, strip->head * 4);
+    }
+    if (dotstar_queue_push(strip)) {
+        strip->frames_sent++;
+    } else {
+        // The strip still shows an older frame, so the next show resends.
+        strip->dirty = 1;
     }
 }
 
-void dotstar_clear()
+void dotstar_h_show_force(dotstar_t * strip)
 {
-	uint32_t i;
-	for (uint8_t * ptr = (uint8_t*)pixels, i = 0; i < numLEDs; i++, ptr += 4) {
-        // Ignore brightness
-		ptr[1] = 0x00;
-        ptr[2] = 0x00;
-        ptr[3] = 0x00;
-	}
+    strip->dirty = 1;
+    dotstar_h_show(strip);
 }
 
-void dotstar_show()
+static void dotstar_free_frames(dotstar_t * strip)
+{
+    for (uint32_t i = 0; i < DOTSTAR_QUEUE_MAX_DEPTH + 2; i++) {
+        dotstar_frame_free(strip, strip->frames[i]);
+        strip->frames[i] = NULL;
+    }
+}
+
+int dotstar_h_set_async(dotstar_t * strip, int enable)
+{
+    if (enable && !strip->async_enabled) {
+        if (strip->numLEDs == 0) {
+            return -1;
+        }
+        for (uint32_t i = 0; i < strip->queue_depth + 2; i++) {
+            strip->frames[i] = dotstar_frame_alloc(strip);
+            if (strip->frames[i] == NULL) {
+                dotstar_free_frames(strip);
+                return -1;
+            }
+        }
+
+        // Frame 0 is the first fill frame and the rest start out free.
+        for (uint32_t i = 0; i < strip->queue_depth; i++) {
+            strip->cells[i].seq = 2 * i;
+        }
+        strip->enqueue_pos = 0;
+        strip->dequeue_pos = 0;
+        strip->fill = 0;
+        for (uint32_t i = 0; i < strip->queue_depth + 1; i++) {
+            strip->free_list[i] = i + 1;
+        }
+        strip->free_head = strip->queue_depth + 1;
+        strip->free_tail = 0;
+        strip->queued = 0;
+        strip->writer_stop = 0;
+        sem_init(&strip->wake, 0, 0);
+        sem_init(&strip->space, 0, 0);
+        sem_init(&strip->idle, 0, 0);
+
+        if (pthread_create(&strip->writer_thread, NULL, dotstar_writer, strip) != 0) {
+            printf("Can't start spi writer thread.\n");
+            sem_destroy(&strip->wake);
+            sem_destroy(&strip->space);
+            sem_destroy(&strip->idle);
+            dotstar_free_frames(strip);
+            return -1;
+        }
+        strip->async_enabled = 1;
+    } else if (!enable && strip->async_enabled) {
+        __atomic_store_n(&strip->writer_stop, 1, __ATOMIC_RELEASE);
+        sem_post(&strip->wake);
+        pthread_join(strip->writer_thread, NULL);
+
+        strip->async_enabled = 0;
+        sem_destroy(&strip->wake);
+        sem_destroy(&strip->space);
+        sem_destroy(&strip->idle);
+        dotstar_free_frames(strip);
+    }
+    return 0;
+}
+
+int dotstar_h_set_queue(dotstar_t * strip, uint32_t depth, dotstar_queue_policy policy)
+{
+    if (depth == 0 || depth > DOTSTAR_QUEUE_MAX_DEPTH || (depth & (depth - 1)) != 0) {
+        return -1;
+    }
+
+    // The writer is restarted around the change, so queued frames are
+    // written first.
+    int async = strip->async_enabled;
+    dotstar_h_set_async(strip, 0);
+    strip->queue_depth = depth;
+    strip->queue_policy = policy;
+    return async ? dotstar_h_set_async(strip, 1) : 0;
+}
+
+void dotstar_h_set_curve(dotstar_t * strip, dotstar_curve curve)
+{
+    strip->curve = curve;
+    strip->dirty = 1;
+}
+
+void dotstar_h_set_dither(dotstar_t * strip, int enable)
 {
-    if (numLEDs == 0) {
+    strip->dither_enabled = enable;
+    strip->dirty = 1;
+    if (strip->dither_error) {
+        memset(strip->dither_error, 0, strip->numLEDs * 3);
+    }
+}
+
+int dotstar_h_set_planar(dotstar_t * strip, int enable)
+{
+    if (enable && strip->plane_data == NULL) {
+        if (strip->numLEDs == 0) {
+            return -1;
+        }
+        uint32_t stride = (strip->numLEDs + 15) & ~15u;
+        void *data;
+        if (posix_memalign(&data, 16, stride * 4) != 0) {
+            return -1;
+        }
+        memset(data, 0, stride * 4);
+        strip->plane_data = (uint8_t *) data;
+        strip->planes.r = strip->plane_data;
+        strip->planes.g = strip->plane_data + stride;
+        strip->planes.b = strip->plane_data + stride * 2;
+        strip->planes.brightness = strip->plane_data + stride * 3;
+
+        // Unpack in pixel order, which is the two halves of the ring.
+        uint32_t first = strip->numLEDs - strip->head;
+        dotstar_planes rest = {
+            strip->planes.r + first, strip->planes.g + first,
+            strip->planes.b + first, strip->planes.brightness + first
+        };
+        dotstar_kernels->unpack(&strip->planes, &strip->pixels[strip->head], first);
+        dotstar_kernels->unpack(&rest, strip->pixels, strip->head);
+    } else if (!enable && strip->plane_data) {
+        dotstar_kernels->pack(strip->pixels, &strip->planes, strip->numLEDs);
+        strip->head = 0;
+        free(strip->plane_data);
+        strip->plane_data = NULL;
+        memset(&strip->planes, 0, sizeof(strip->planes));
+        strip->dirty = 1;
+    }
+    return 0;
+}
+
+dotstar_planes dotstar_h_get_planes(dotstar_t * strip)
+{
+    if (strip->plane_data) {
+        strip->dirty = 1;
+    }
+    return strip->planes;
+}
+
+void dotstar_h_wait(dotstar_t * strip)
+{
+    if (!strip->async_enabled) {
         return;
     }
-    
-    xfer[0].tx_buf = (unsigned long)header_data;
-    xfer[1].tx_buf = (unsigned long)pixels;
-    xfer[2].tx_buf = (unsigned long)footer_data;
 
-    int ret = ioctl(fd, SPI_IOC_MESSAGE(3), xfer);
-	if (ret < 1) {
-		printf("Can't send spi message.\n");
+    while (__atomic_load_n(&strip->queued, __ATOMIC_ACQUIRE) != 0) {
+        sem_wait(&strip->idle);
     }
 }
 
-void dotstar_set_pixel(uint16_t p, uint8_t r, uint8_t g, uint8_t b, uint8_t brightness)
+uint32_t dotstar_h_get_dropped_frames(dotstar_t * strip)
+{
+    return __atomic_load_n(&strip->frames_dropped, __ATOMIC_RELAXED);
+}
+
+uint32_t dotstar_h_get_sent_frames(dotstar_t * strip)
+{
+    return strip->frames_sent;
+}
+
+uint32_t dotstar_h_get_skipped_frames(dotstar_t * strip)
+{
+    return strip->frames_skipped;
+}
+
+uint32_t dotstar_h_num_leds(const dotstar_t * strip)
+{
+    return strip->numLEDs;
+}
+
+void dotstar_h_set_pixel(dotstar_t * strip, uint32_t p, uint8_t r, uint8_t g, uint8_t b, uint8_t brightness)
 {
-	if (p < numLEDs) {
-		uint8_t *ptr = (uint8_t*)&pixels[p];
-		ptr[3] = r;
-		ptr[2] = g;
-		ptr[1] = b;
+	if (p < strip->numLEDs) {
+		uint8_t *ptr = (uint8_t*)&strip->pixels[dotstar_slot(strip, p)];
+		strip->dirty = 1;
+		ptr[DOTSTAR_RED_BYTE] = r;
+		ptr[DOTSTAR_GREEN_BYTE] = g;
+		ptr[DOTSTAR_BLUE_BYTE] = b;
         if (brightness > PIXEL_MAX_BRIGHTNESS) {
             brightness = PIXEL_MAX_BRIGHTNESS;
         }
-        ptr[0] = brightness | 0xE0;
+        ptr[0] = brightness | DOTSTAR_START_BITS;
 	}
 }
 
-void dotstar_set_pixel_red(uint16_t p, uint8_t r)
+// Convert rgbb pixels to the wire format.
+static void dotstar_pack_rgbb(uint8_t * dst, const dotstar_rgbb * src, uint32_t count)
+{
+    uint32_t i = 0;
+#if defined(__ARM_NEON)
+    const uint8x16_t max = vdupq_n_u8(PIXEL_MAX_BRIGHTNESS);
+    const uint8x16_t start = vdupq_n_u8(DOTSTAR_START_BITS);
+    for (; i + 16 <= count; i += 16) {
+        uint8x16x4_t in = vld4q_u8((const uint8_t*)&src[i]);
+        uint8x16x4_t out;
+        out.val[0] = vorrq_u8(vminq_u8(in.val[3], max), start);
+        out.val[DOTSTAR_RED_BYTE] = in.val[0];
+        out.val[DOTSTAR_GREEN_BYTE] = in.val[1];
+        out.val[DOTSTAR_BLUE_BYTE] = in.val[2];
+        vst4q_u8(&dst[i * 4], out);
+    }
+#endif
+    for (; i < count; i++) {
+        uint8_t brightness = src[i].brightness;
+        if (brightness > PIXEL_MAX_BRIGHTNESS) {
+            brightness = PIXEL_MAX_BRIGHTNESS;
+        }
+        dst[i * 4 + 0] = brightness | DOTSTAR_START_BITS;
+        dst[i * 4 + DOTSTAR_RED_BYTE] = src[i].r;
+        dst[i * 4 + DOTSTAR_GREEN_BYTE] = src[i].g;
+        dst[i * 4 + DOTSTAR_BLUE_BYTE] = src[i].b;
+    }
+}
+
+void dotstar_h_set_pixels(dotstar_t * strip, uint32_t offset, uint32_t count, const dotstar_rgbb * src)
+{
+    if (offset >= strip->numLEDs) {
+        return;
+    }
+    if (count > strip->numLEDs - offset) {
+        count = strip->numLEDs - offset;
+    }
+
+    // The run covers at most the two halves of the ring.
+    uint32_t slot = dotstar_slot(strip, offset);
+    uint32_t first = strip->numLEDs - slot;
+    if (first > count) {
+        first = count;
+    }
+    dotstar_pack_rgbb((uint8_t*)&strip->pixels[slot], src, first);
+    dotstar_pack_rgbb((uint8_t*)strip->pixels, &src[first], count - first);
+    strip->dirty = 1;
+}
+
+void dotstar_h_set_pixels_packed(dotstar_t * strip, uint32_t offset, uint32_t count, const uint32_t * src)
+{
+    if (offset >= strip->numLEDs) {
+        return;
+    }
+    if (count > strip->numLEDs - offset) {
+        count = strip->numLEDs - offset;
+    }
+
+    uint32_t slot = dotstar_slot(strip, offset);
+    uint32_t first = strip->numLEDs - slot;
+    if (first > count) {
+        first = count;
+    }
+    memcpy(&strip->pixels[slot], src, first * 4);
+    memcpy(strip->pixels, &src[first], (count - first) * 4);
+    strip->dirty = 1;
+}
+
+uint32_t dotstar_h_get_pixels_packed(dotstar_t * strip, uint32_t offset, uint32_t count, uint32_t * dst)
 {
-	if (p < numLEDs) {
-		uint8_t *ptr = (uint8_t*)&pixels[p];
-		ptr[3] = r;
+    if (offset >= strip->numLEDs) {
+        return 0;
+    }
+    if (count > strip->numLEDs - offset) {
+        count = strip->numLEDs - offset;
+    }
+
+    uint32_t slot = dotstar_slot(strip, offset);
+    uint32_t first = strip->numLEDs - slot;
+    if (first > count) {
+        first = count;
+    }
+    memcpy(dst, &strip->pixels[slot], first * 4);
+    memcpy(&dst[first], strip->pixels, (count - first) * 4);
+    return count;
+}
+
+void dotstar_h_set_pixel_red(dotstar_t * strip, uint32_t p, uint8_t r)
+{
+	if (p < strip->numLEDs) {
+		uint8_t *ptr = (uint8_t*)&strip->pixels[dotstar_slot(strip, p)];
+		strip->dirty = 1;
+		ptr[DOTSTAR_RED_BYTE] = r;
 	}
 }
 
-void dotstar_set_pixel_green(uint16_t p, uint8_t g)
+void dotstar_h_set_pixel_green(dotstar_t * strip, uint32_t p, uint8_t g)
 {
-	if (p < numLEDs) {
-		uint8_t *ptr = (uint8_t*)&pixels[p];
-		ptr[2] = g;
+	if (p < strip->numLEDs) {
+		uint8_t *ptr = (uint8_t*)&strip->pixels[dotstar_slot(strip, p)];
+		strip->dirty = 1;
+		ptr[DOTSTAR_GREEN_BYTE] = g;
 	}
 }
 
-void dotstar_set_pixel_blue(uint16_t p, uint8_t b)
+void dotstar_h_set_pixel_blue(dotstar_t * strip, uint32_t p, uint8_t b)
 {
-	if (p < numLEDs) {
-		uint8_t *ptr = (uint8_t*)&pixels[p];
-		ptr[1] = b;
+	if (p < strip->numLEDs) {
+		uint8_t *ptr = (uint8_t*)&strip->pixels[dotstar_slot(strip, p)];
+		strip->dirty = 1;
+		ptr[DOTSTAR_BLUE_BYTE] = b;
 	}
 }
 
-void dotstar_set_pixel_brightness(uint16_t p, uint8_t brightness)
+void dotstar_h_set_pixel_brightness(dotstar_t * strip, uint32_t p, uint8_t brightness)
 {
-	if (p < numLEDs) {
-		uint8_t *ptr = (uint8_t*)&pixels[p];
+	if (p < strip->numLEDs) {
+		uint8_t *ptr = (uint8_t*)&strip->pixels[dotstar_slot(strip, p)];
+		strip->dirty = 1;
         if (brightness > PIXEL_MAX_BRIGHTNESS) {
             brightness = PIXEL_MAX_BRIGHTNESS;
         }
-        ptr[0] = brightness | 0xE0;
+        ptr[0] = brightness | DOTSTAR_START_BITS;
 	}
 }
 
-uint8_t dotstar_get_pixel_red(uint16_t p)
+uint8_t dotstar_h_get_pixel_red(dotstar_t * strip, uint32_t p)
 {
-    if (p < numLEDs) {
-        uint8_t *ptr = (uint8_t*)&pixels[p];
-	    return ptr[3];
+    if (p < strip->numLEDs) {
+        uint8_t *ptr = (uint8_t*)&strip->pixels[dotstar_slot(strip, p)];
+	    return ptr[DOTSTAR_RED_BYTE];
 	} else {
         return 0;
     }
 }
 
-uint8_t dotstar_get_pixel_green(uint16_t p)
+uint8_t dotstar_h_get_pixel_green(dotstar_t * strip, uint32_t p)
 {
-    if (p < numLEDs) {
-        uint8_t *ptr = (uint8_t*)&pixels[p];
-	    return ptr[2];
+    if (p < strip->numLEDs) {
+        uint8_t *ptr = (uint8_t*)&strip->pixels[dotstar_slot(strip, p)];
+	    return ptr[DOTSTAR_GREEN_BYTE];
 	} else {
         return 0;
     }
 }
 
-uint8_t dotstar_get_pixel_blue(uint16_t p)
+uint8_t dotstar_h_get_pixel_blue(dotstar_t * strip, uint32_t p)
 {
-    if (p < numLEDs) {
-        uint8_t *ptr = (uint8_t*)&pixels[p];
-	    return ptr[1];
+    if (p < strip->numLEDs) {
+        uint8_t *ptr = (uint8_t*)&strip->pixels[dotstar_slot(strip, p)];
+	    return ptr[DOTSTAR_BLUE_BYTE];
 	} else {
         return 0;
     }
 }
 
-uint8_t dotstar_get_pixel_brightness(uint16_t p)
+uint8_t dotstar_h_get_pixel_brightness(dotstar_t * strip, uint32_t p)
 {
-    if (p < numLEDs) {
-        uint8_t *ptr = (uint8_t*)&pixels[p];
+    if (p < strip->numLEDs) {
+        uint8_t *ptr = (uint8_t*)&strip->pixels[dotstar_slot(strip, p)];
 	    return ptr[0] & 0x0F;
 	} else {
         return 0;
     }
 }
 
-void dotstar_set_strip(uint8_t r, uint8_t g, uint8_t b, uint8_t brightness)
+void dotstar_h_set_strip(dotstar_t * strip, uint8_t r, uint8_t g, uint8_t b, uint8_t brightness)
+{
+    dotstar_kernels->fill(strip->pixels, strip->numLEDs, dotstar_kernel_pixel(r, g, b, brightness));
+    strip->dirty = 1;
+}
+
+void dotstar_h_set_strip_gradient(dotstar_t * strip,
+                                  uint8_t r1, uint8_t g1, uint8_t b1, uint8_t brightness1,
+                                  uint8_t r2, uint8_t g2, uint8_t b2, uint8_t brightness2)
+{
+    uint32_t from = dotstar_kernel_pixel(r1, g1, b1, brightness1);
+    uint32_t to = dotstar_kernel_pixel(r2, g2, b2, brightness2);
+    uint32_t first = strip->numLEDs - strip->head;
+
+    // Pixel 0 is at head, so the ring end holds the start of the gradient.
+    dotstar_kernels->gradient(&strip->pixels[strip->head], first, from, to, 0, strip->numLEDs);
+    dotstar_kernels->gradient(strip->pixels, strip->head, from, to, first, strip->numLEDs);
+    strip->dirty = 1;
+}
+
+void dotstar_h_scale_strip(dotstar_t * strip, uint8_t r, uint8_t g, uint8_t b)
+{
+    dotstar_kernels->scale(strip->pixels, strip->pixels, strip->numLEDs, r, g, b);
+    strip->dirty = 1;
+}
+
+void dotstar_h_strip_push_pixel_front(dotstar_t * strip, uint8_t r, uint8_t g, uint8_t b, uint8_t brightness)
+{
+    // The pixel at the end wraps around to index 0 and is overwritten.
+    dotstar_h_strip_rotate_right(strip);
+    dotstar_h_set_pixel(strip, 0, r, g, b, brightness);
+}
+
+void dotstar_h_strip_push_pixel_back(dotstar_t * strip, uint8_t r, uint8_t g, uint8_t b, uint8_t brightness)
+{
+    // The pixel at the front wraps around to the end and is overwritten.
+    dotstar_h_strip_rotate_left(strip);
+    dotstar_h_set_pixel(strip, strip->numLEDs - 1, r, g, b, brightness);
+}
+
+void dotstar_h_strip_rotate_left(dotstar_t * strip)
 {
-    if (brightness > PIXEL_MAX_BRIGHTNESS) {
-        brightness = PIXEL_MAX_BRIGHTNESS;
+    if (strip->numLEDs == 0) {
+        return;
     }
-    for (uint8_t * ptr = (uint8_t*)pixels, i = 0; i < numLEDs; i++, ptr += 4) {
-        ptr[0] = brightness | 0xE0;
-		ptr[1] = b;
-        ptr[2] = g;
-        ptr[3] = r;
-	}
+    strip->head = (strip->head + 1 == strip->numLEDs) ? 0 : strip->head + 1;
+    strip->dirty = 1;
+}
+
+void dotstar_h_strip_rotate_right(dotstar_t * strip)
+{
+    if (strip->numLEDs == 0) {
+        return;
+    }
+    strip->head = (strip->head == 0) ? strip->numLEDs - 1 : strip->head - 1;
+    strip->dirty = 1;
+}
+
+//======================================================================
+// Functions without a handle operate on the strip opened by dotstar_create().
+
+int dotstar_create(const char * device,
+                   uint32_t frequency,
+                   uint32_t num_leds)
+{
+    dotstar_t *strip = dotstar_h_open(device, frequency, num_leds);
+    if (strip == NULL) {
+        return -1;
+    }
+
+    dotstar_destroy();
+    default_strip = strip;
+	return 0;
+}
+
+void dotstar_destroy()
+{
+    dotstar_h_close(default_strip);
+    default_strip = &no_strip;
+}
+
+dotstar_t * dotstar_get_default()
+{
+    return default_strip;
+}
+
+void dotstar_clear()
+{
+    dotstar_h_clear(default_strip);
+}
+
+void dotstar_show()
+{
+    dotstar_h_show(default_strip);
+}
+
+void dotstar_show_force()
+{
+    dotstar_h_show_force(default_strip);
+}
+
+int dotstar_set_async(int enable)
+{
+    return dotstar_h_set_async(default_strip, enable);
+}
+
+int dotstar_set_queue(uint32_t depth, dotstar_queue_policy policy)
+{
+    return dotstar_h_set_queue(default_strip, depth, policy);
+}
+
+void dotstar_set_curve(dotstar_curve curve)
+{
+    dotstar_h_set_curve(default_strip, curve);
+}
+
+void dotstar_set_dither(int enable)
+{
+    dotstar_h_set_dither(default_strip, enable);
+}
+
+int dotstar_set_planar(int enable)
+{
+    return dotstar_h_set_planar(default_strip, enable);
+}
+
+dotstar_planes dotstar_get_planes()
+{
+    return dotstar_h_get_planes(default_strip);
+}
+
+void dotstar_wait()
+{
+    dotstar_h_wait(default_strip);
+}
+
+uint32_t dotstar_get_dropped_frames()
+{
+    return dotstar_h_get_dropped_frames(default_strip);
+}
+
+uint32_t dotstar_get_sent_frames()
+{
+    return dotstar_h_get_sent_frames(default_strip);
+}
+
+uint32_t dotstar_get_skipped_frames()
+{
+    return dotstar_h_get_skipped_frames(default_strip);
+}
+
+void dotstar_set_pixel(uint32_t p, uint8_t r, uint8_t g, uint8_t b, uint8_t brightness)
+{
+    dotstar_h_set_pixel(default_strip, p, r, g, b, brightness);
+}
+
+void dotstar_set_pixels(uint32_t offset, uint32_t count, const dotstar_rgbb * src)
+{
+    dotstar_h_set_pixels(default_strip, offset, count, src);
+}
+
+void dotstar_set_pixels_packed(uint32_t offset, uint32_t count, const uint32_t * src)
+{
+    dotstar_h_set_pixels_packed(default_strip, offset, count, src);
+}
+
+uint32_t dotstar_get_pixels_packed(uint32_t offset, uint32_t count, uint32_t * dst)
+{
+    return dotstar_h_get_pixels_packed(default_strip, offset, count, dst);
+}
+
+void dotstar_set_pixel_red(uint32_t p, uint8_t r)
+{
+    dotstar_h_set_pixel_red(default_strip, p, r);
+}
+
+void dotstar_set_pixel_green(uint32_t p, uint8_t g)
+{
+    dotstar_h_set_pixel_green(default_strip, p, g);
+}
+
+void dotstar_set_pixel_blue(uint32_t p, uint8_t b)
+{
+    dotstar_h_set_pixel_blue(default_strip, p, b);
+}
+
+void dotstar_set_pixel_brightness(uint32_t p, uint8_t brightness)
+{
+    dotstar_h_set_pixel_brightness(default_strip, p, brightness);
+}
+
+uint8_t dotstar_get_pixel_red(uint32_t p)
+{
+    return dotstar_h_get_pixel_red(default_strip, p);
+}
+
+uint8_t dotstar_get_pixel_green(uint32_t p)
+{
+    return dotstar_h_get_pixel_green(default_strip, p);
+}
+
+uint8_t dotstar_get_pixel_blue(uint32_t p)
+{
+    return dotstar_h_get_pixel_blue(default_strip, p);
+}
+
+uint8_t dotstar_get_pixel_brightness(uint32_t p)
+{
+    return dotstar_h_get_pixel_brightness(default_strip, p);
+}
+
+void dotstar_set_strip(uint8_t r, uint8_t g, uint8_t b, uint8_t brightness)
+{
+    dotstar_h_set_strip(default_strip, r, g, b, brightness);
+}
+
+void dotstar_set_strip_gradient(uint8_t r1, uint8_t g1, uint8_t b1, uint8_t brightness1,
+                                uint8_t r2, uint8_t g2, uint8_t b2, uint8_t brightness2)
+{
+    dotstar_h_set_strip_gradient(default_strip, r1, g1, b1, brightness1, r2, g2, b2, brightness2);
+}
+
+void dotstar_scale_strip(uint8_t r, uint8_t g, uint8_t b)
+{
+    dotstar_h_scale_strip(default_strip, r, g, b);
 }
 
 void dotstar_strip_push_pixel_front(uint8_t r, uint8_t g, uint8_t b, uint8_t brightness)
 {
-    uint32_t i;
-	for (uint8_t * ptr = (uint8_t*)&pixels[numLEDs-2], i = 0; i < numLEDs-1; i++, ptr -= 4) {
-        ptr[4] = ptr[0];
-		ptr[5] = ptr[1];
-        ptr[6] = ptr[2];
-        ptr[7] = ptr[3];
-	}
-    dotstar_set_pixel(0, r, g, b, brightness);
+    dotstar_h_strip_push_pixel_front(default_strip, r, g, b, brightness);
 }
 
 void dotstar_strip_push_pixel_back(uint8_t r, uint8_t g, uint8_t b, uint8_t brightness)
 {
-    uint32_t i;
-	for (uint8_t * ptr = (uint8_t*)pixels, i = 0; i < numLEDs-1; i++, ptr += 4) {
-        ptr[0] = ptr[4];
-		ptr[1] = ptr[5];
-        ptr[2] = ptr[6];
-        ptr[3] = ptr[7];
-	}
-    dotstar_set_pixel(numLEDs - 1, r, g, b, brightness);
+    dotstar_h_strip_push_pixel_back(default_strip, r, g, b, brightness);
 }
 
 void dotstar_strip_rotate_left()
 {
-    uint32_t i;
-    uint8_t r, g, b, brightness;
-    brightness = dotstar_get_pixel_brightness(0);
-	b = dotstar_get_pixel_blue(0);
-    g = dotstar_get_pixel_green(0);
-    r = dotstar_get_pixel_red(0);
-    
-    dotstar_strip_push_pixel_back(r, g, b, brightness);
+    dotstar_h_strip_rotate_left(default_strip);
 }
 
 void dotstar_strip_rotate_right()
 {
-    uint32_t i;
-    uint8_t r, g, b, brightness;
-    brightness = dotstar_get_pixel_brightness(numLEDs - 1);
-	b = dotstar_get_pixel_blue(numLEDs - 1);
-    g = dotstar_get_pixel_green(numLEDs - 1);
-    r = dotstar_get_pixel_red(numLEDs - 1);
-    
-    dotstar_strip_push_pixel_front(r, g, b, brightness);
+    dotstar_h_strip_rotate_right(default_strip);
 }
 
 #if defined(DOTSTAR_STANDALONE)
@@ -20,6 +20,51 @@
 
 #include <stdint.h>
 
+/*
+@brief Curve applied to the color channels when a frame is shown.
+*/
+typedef enum {
+    DOTSTAR_CURVE_LINEAR,   // Channels are sent as is
+    DOTSTAR_CURVE_GAMMA,    // Power curve, see LUT_GAMMA in lut_tables.h
+    DOTSTAR_CURVE_CIE       // Channels are CIE 1976 lightness
+} dotstar_curve;
+
+/*
+@brief Planar working copy of the strip, one byte per pixel in each plane.
+       Plane index 0 is pixel 0. Each plane starts on a 16-byte boundary and
+       is padded to a multiple of 16 bytes, so effects can process whole
+       vectors. See dotstar_set_planar().
+*/
+typedef struct {
+    uint8_t * r;
+    uint8_t * g;
+    uint8_t * b;
+    uint8_t * brightness;   // 0 to PIXEL_MAX_BRIGHTNESS
+} dotstar_planes;
+
+/*
+@brief What dotstar_show() does in asynchronous mode when the queue of frames
+       waiting for the writer thread is full.
+*/
+typedef enum {
+    DOTSTAR_QUEUE_DROP_OLDEST,  // Replace the oldest queued frame
+    DOTSTAR_QUEUE_DROP_NEWEST,  // Discard the frame being shown
+    DOTSTAR_QUEUE_BLOCK         // Wait until the writer takes a frame
+} dotstar_queue_policy;
+
+#define DOTSTAR_QUEUE_MAX_DEPTH 16
+
+/*
+@brief One pixel as color components and global brightness, used by
+       dotstar_set_pixels().
+*/
+typedef struct {
+    uint8_t r;
+    uint8_t g;
+    uint8_t b;
+    uint8_t brightness;
+} dotstar_rgbb;
+
 /*
 @brief Opens the SPI device.
 
@@ -28,7 +73,9 @@
                   because hardware SPI speed is a function of the system core
                   frequency and the smallest power-of-two prescaler
                   that will not exceed the requested rate.
-@param numLEDs  The number of LEDs in the strip. Must be > 0.
+@param numLEDs  The number of LEDs in the strip. Must be > 0. Strips longer
+                than spidev's bufsiz allows in one message are sent in
+                several messages.
 @return 0 on success, nonzero otherwise
 */
 int dotstar_create(const char * device,
@@ -47,10 +94,124 @@ void dotstar_destroy();
 void dotstar_clear();
 
 /*
-@brief Write the internal buffer to the LED strip.
+@brief Write the internal buffer to the LED strip. In asynchronous mode the
+       frame is handed to the writer thread and this returns immediately, so
+       the next frame can be rendered while this one is on the wire. If
+       nothing changed since the last frame was sent, the frame is skipped
+       and the bus is left alone. With dithering enabled every frame is sent.
 */
 void dotstar_show();
 
+/*
+@brief Write the internal buffer to the LED strip even if nothing changed,
+       for example after the strip lost power.
+*/
+void dotstar_show_force();
+
+/*
+@brief Enable or disable asynchronous output. When enabled, a writer thread
+       owns the SPI transfer and dotstar_show() only queues a copy of the
+       frame. The handoff is lock free, so while the queue has room the
+       thread that renders does not wait on the writer. When the queue is
+       full, dotstar_set_queue() decides: the drop policies return at once,
+       and DOTSTAR_QUEUE_BLOCK waits until the writer takes a frame.
+       Disabling waits for the queued frames to be written.
+
+@param enable  Nonzero to enable, zero to disable
+@return 0 on success, nonzero otherwise
+*/
+int dotstar_set_async(int enable);
+
+/*
+@brief Set the number of frames that can wait for the writer thread and what
+       happens when the queue is full. Dropped frames are counted by
+       dotstar_get_dropped_frames(). The default is a depth of 1 with
+       DOTSTAR_QUEUE_DROP_OLDEST, so a frame that has not been picked up by
+       the time the next one is shown is replaced by it.
+
+@param depth  Queue depth. Must be a power of two no larger than
+              DOTSTAR_QUEUE_MAX_DEPTH.
+@param policy  What to do when the queue is full
+@return 0 on success, nonzero otherwise
+*/
+int dotstar_set_queue(uint32_t depth, dotstar_queue_policy policy);
+
+/*
+@brief Select the curve that maps channel values to light output. With any
+       curve other than DOTSTAR_CURVE_LINEAR, dotstar_show() renders each
+       frame through the curve at 16 bits per channel and picks the global
+       brightness of each pixel so dim colors keep their resolution. The
+       pixel values in the buffer are not changed.
+
+@param curve  The curve to use. The default is DOTSTAR_CURVE_LINEAR.
+*/
+void dotstar_set_curve(dotstar_curve curve);
+
+/*
+@brief Enable or disable temporal dithering. When enabled, the part of each
+       channel that falls between two 8-bit steps is carried over to the next
+       frame, so shades between steps are reached on average. Frames should
+       then be shown at a steady rate, even when nothing changes.
+
+@param enable  Nonzero to enable, zero to disable
+*/
+void dotstar_set_dither(int enable);
+
+/*
+@brief Enable or disable planar mode. In planar mode effects work on
+       separate red, green, blue and brightness arrays from
+       dotstar_get_planes() instead of on the packed pixels, and
+       dotstar_show() packs the planes into the pixel buffer in one pass.
+       The planes then are the frame, so changes made with the other pixel
+       and strip functions are lost when the frame is shown. Enabling copies
+       the current frame into the planes and disabling copies the planes
+       back.
+
+@param enable  Nonzero to enable, zero to disable
+@return 0 on success, nonzero otherwise
+*/
+int dotstar_set_planar(int enable);
+
+/*
+@brief Get the planes to change them. The strip is marked as changed, so
+       call this again before each frame that changes the planes.
+
+@return The planes. The pointers are NULL when planar mode is off.
+*/
+dotstar_planes dotstar_get_planes();
+
+/*
+@brief Block until every frame handed to dotstar_show() has been written to
+       the strip. Returns immediately in synchronous mode.
+*/
+void dotstar_wait();
+
+/*
+@brief Get the number of frames that were dropped because the queue for the
+       writer thread was full.
+
+@return dropped frame count since dotstar_create()
+*/
+uint32_t dotstar_get_dropped_frames();
+
+/*
+@brief Get the number of frames dotstar_show() sent to the strip or, in
+       asynchronous mode, handed to the writer thread. A frame dropped by
+       DOTSTAR_QUEUE_DROP_NEWEST is not counted, and the next dotstar_show()
+       sends the pixels again even if they did not change.
+
+@return sent frame count since dotstar_create()
+*/
+uint32_t dotstar_get_sent_frames();
+
+/*
+@brief Get the number of frames dotstar_show() skipped because nothing
+       changed.
+
+@return skipped frame count since dotstar_create()
+*/
+uint32_t dotstar_get_skipped_frames();
+
 /*
 @brief Set a pixel to a given color and brightness
 
@@ -61,7 +222,42 @@ void dotstar_show();
 @param brightness  The global brightness of the pixel, independent of color.
                    Max brightness is 15.
 */
-void dotstar_set_pixel(uint16_t p, uint8_t r, uint8_t g, uint8_t b, uint8_t brightness);
+void dotstar_set_pixel(uint32_t p, uint8_t r, uint8_t g, uint8_t b, uint8_t brightness);
+
+/*
+@brief Set a run of pixels from an array. The run is clipped to the end of
+       the strip.
+
+@param offset  The index of the first pixel to set, starting at 0
+@param count  The number of pixels to set
+@param src  The pixel values. Brightness is limited to PIXEL_MAX_BRIGHTNESS.
+*/
+void dotstar_set_pixels(uint32_t offset, uint32_t count, const dotstar_rgbb * src);
+
+/*
+@brief Set a run of pixels from data that is already in the strip's wire
+       format, 4 bytes per pixel: the start bits ORed with the 5-bit
+       brightness, then the colors in the order of the build's chipset (see
+       DOTSTAR_CHIPSET_LIST in dotstar_chipset.h). The data is copied as is.
+       The run is clipped to the end of the strip.
+
+@param offset  The index of the first pixel to set, starting at 0
+@param count  The number of pixels to set
+@param src  The packed pixel data
+*/
+void dotstar_set_pixels_packed(uint32_t offset, uint32_t count, const uint32_t * src);
+
+/*
+@brief Copy a run of pixels out of the strip in its wire format, the
+       reverse of dotstar_set_pixels_packed(). The run is clipped to the end
+       of the strip.
+
+@param offset  The index of the first pixel to get, starting at 0
+@param count  The number of pixels to get
+@param dst  Receives the packed pixel data
+@return the number of pixels copied
+*/
+uint32_t dotstar_get_pixels_packed(uint32_t offset, uint32_t count, uint32_t * dst);
 
 /*
 @brief Set the red component of a pixel
@@ -69,7 +265,7 @@ void dotstar_set_pixel(uint16_t p, uint8_t r, uint8_t g, uint8_t b, uint8_t brig
 @param p  The pixel index, starting at 0
 @param r  red
 */
-void dotstar_set_pixel_red(uint16_t p, uint8_t r);
+void dotstar_set_pixel_red(uint32_t p, uint8_t r);
 
 /*
 @brief Set the green component of a pixel
@@ -77,7 +273,7 @@ void dotstar_set_pixel_red(uint16_t p, uint8_t r);
 @param p  The pixel index, starting at 0
 @param g  green
 */
-void dotstar_set_pixel_green(uint16_t p, uint8_t g);
+void dotstar_set_pixel_green(uint32_t p, uint8_t g);
 
 /*
 @brief Set the blue component of a pixel
@@ -85,7 +281,7 @@ void dotstar_set_pixel_green(uint16_t p, uint8_t g);
 @param p  The pixel index, starting at 0
 @param b  blue
 */
-void dotstar_set_pixel_blue(uint16_t p, uint8_t b);
+void dotstar_set_pixel_blue(uint32_t p, uint8_t b);
 
 /*
 @brief Set the global brightness of a pixel
@@ -94,7 +290,7 @@ void dotstar_set_pixel_blue(uint16_t p, uint8_t b);
 @param brightness  The global brightness of the pixel, independent of color.
                    Max brightness is 15.
 */
-void dotstar_set_pixel_brightness(uint16_t p, uint8_t brightness);
+void dotstar_set_pixel_brightness(uint32_t p, uint8_t brightness);
 
 /*
 @brief Get the red component of a pixel
@@ -102,7 +298,7 @@ void dotstar_set_pixel_brightness(uint16_t p, uint8_t brightness);
 @param p  The pixel index, starting at 0
 @return red value of the pixel
 */
-uint8_t dotstar_get_pixel_red(uint16_t p);
+uint8_t dotstar_get_pixel_red(uint32_t p);
 
 /*
 @brief Get the green component of a pixel
@@ -110,7 +306,7 @@ uint8_t dotstar_get_pixel_red(uint16_t p);
 @param p  The pixel index, starting at 0
 @return green value of the pixel
 */
-uint8_t dotstar_get_pixel_green(uint16_t p);
+uint8_t dotstar_get_pixel_green(uint32_t p);
 
 /*
 @brief Get the blue component of a pixel
@@ -118,7 +314,7 @@ uint8_t dotstar_get_pixel_green(uint16_t p);
 @param p  The pixel index, starting at 0
 @return blue value of the pixel
 */
-uint8_t dotstar_get_pixel_blue(uint16_t p);
+uint8_t dotstar_get_pixel_blue(uint32_t p);
 
 /*
 @brief Get the global brightness of a pixel
@@ -127,7 +323,7 @@ uint8_t dotstar_get_pixel_blue(uint16_t p);
 @return brightness  The global brightness of the pixel, independent of color.
                     Max brightness is 15.
 */
-uint8_t dotstar_get_pixel_brightness(uint16_t p);
+uint8_t dotstar_get_pixel_brightness(uint32_t p);
 
 /*
 @brief Set the whole strip to a given color and brightness
@@ -140,6 +336,31 @@ uint8_t dotstar_get_pixel_brightness(uint16_t p);
 */
 void dotstar_set_strip(uint8_t r, uint8_t g, uint8_t b, uint8_t brightness);
 
+/*
+@brief Set the whole strip to a linear gradient between two colors. Pixel 0
+       gets the first color and the last pixel gets the second.
+
+@param r1  red at pixel 0
+@param g1  green at pixel 0
+@param b1  blue at pixel 0
+@param brightness1  global brightness at pixel 0. Max brightness is 15.
+@param r2  red at the last pixel
+@param g2  green at the last pixel
+@param b2  blue at the last pixel
+@param brightness2  global brightness at the last pixel. Max brightness is 15.
+*/
+void dotstar_set_strip_gradient(uint8_t r1, uint8_t g1, uint8_t b1, uint8_t brightness1,
+                                uint8_t r2, uint8_t g2, uint8_t b2, uint8_t brightness2);
+
+/*
+@brief Scale the color of every pixel. Global brightness is not changed.
+
+@param r  red factor. 255 leaves red unchanged and 0 turns it off.
+@param g  green factor
+@param b  blue factor
+*/
+void dotstar_scale_strip(uint8_t r, uint8_t g, uint8_t b);
+
 /*
 @brief Push a pixel into the front of the strip and move all other pixels
        over. The pixel at the end is dropped.
@@ -176,4 +397,77 @@ void dotstar_strip_rotate_left();
 */
 void dotstar_strip_rotate_right();
 
+/*
+@brief Handle to one LED strip. The functions above operate on the strip
+       opened by dotstar_create(). The dotstar_h_ functions below take the
+       strip as their first argument and otherwise behave like the function
+       of the same name without the h_, so several strips can be driven from
+       one process. Each strip has its own buffers and, in asynchronous mode,
+       its own writer thread. A single strip must not be used from several
+       threads at once.
+*/
+typedef struct dotstar dotstar_t;
+
+/*
+@brief Open the SPI device for a new strip. See dotstar_create().
+
+@return The new strip, or NULL on failure
+*/
+dotstar_t * dotstar_h_open(const char * device,
+                           uint32_t frequency,
+                           uint32_t numLEDs);
+
+/*
+@brief Close the SPI device of a strip and free it. See dotstar_destroy().
+*/
+void dotstar_h_close(dotstar_t * strip);
+
+/*
+@brief Get the strip opened by dotstar_create(). Until dotstar_create()
+       succeeds this is an empty strip on which every function does nothing.
+
+@return The strip. Never NULL.
+*/
+dotstar_t * dotstar_get_default();
+
+/*
+@brief Get the number of LEDs in a strip.
+*/
+uint32_t dotstar_h_num_leds(const dotstar_t * strip);
+
+void dotstar_h_clear(dotstar_t * strip);
+void dotstar_h_show(dotstar_t * strip);
+void dotstar_h_show_force(dotstar_t * strip);
+int dotstar_h_set_async(dotstar_t * strip, int enable);
+int dotstar_h_set_queue(dotstar_t * strip, uint32_t depth, dotstar_queue_policy policy);
+void dotstar_h_set_curve(dotstar_t * strip, dotstar_curve curve);
+void dotstar_h_set_dither(dotstar_t * strip, int enable);
+int dotstar_h_set_planar(dotstar_t * strip, int enable);
+dotstar_planes dotstar_h_get_planes(dotstar_t * strip);
+void dotstar_h_wait(dotstar_t * strip);
+uint32_t dotstar_h_get_dropped_frames(dotstar_t * strip);
+uint32_t dotstar_h_get_sent_frames(dotstar_t * strip);
+uint32_t dotstar_h_get_skipped_frames(dotstar_t * strip);
+void dotstar_h_set_pixel(dotstar_t * strip, uint32_t p, uint8_t r, uint8_t g, uint8_t b, uint8_t brightness);
+void dotstar_h_set_pixels(dotstar_t * strip, uint32_t offset, uint32_t count, const dotstar_rgbb * src);
+void dotstar_h_set_pixels_packed(dotstar_t * strip, uint32_t offset, uint32_t count, const uint32_t * src);
+uint32_t dotstar_h_get_pixels_packed(dotstar_t * strip, uint32_t offset, uint32_t count, uint32_t * dst);
+void dotstar_h_set_pixel_red(dotstar_t * strip, uint32_t p, uint8_t r);
+void dotstar_h_set_pixel_green(dotstar_t * strip, uint32_t p, uint8_t g);
+void dotstar_h_set_pixel_blue(dotstar_t * strip, uint32_t p, uint8_t b);
+void dotstar_h_set_pixel_brightness(dotstar_t * strip, uint32_t p, uint8_t brightness);
+uint8_t dotstar_h_get_pixel_red(dotstar_t * strip, uint32_t p);
+uint8_t dotstar_h_get_pixel_green(dotstar_t * strip, uint32_t p);
+uint8_t dotstar_h_get_pixel_blue(dotstar_t * strip, uint32_t p);
+uint8_t dotstar_h_get_pixel_brightness(dotstar_t * strip, uint32_t p);
+void dotstar_h_set_strip(dotstar_t * strip, uint8_t r, uint8_t g, uint8_t b, uint8_t brightness);
+void dotstar_h_set_strip_gradient(dotstar_t * strip,
+                                  uint8_t r1, uint8_t g1, uint8_t b1, uint8_t brightness1,
+                                  uint8_t r2, uint8_t g2, uint8_t b2, uint8_t brightness2);
+void dotstar_h_scale_strip(dotstar_t * strip, uint8_t r, uint8_t g, uint8_t b);
+void dotstar_h_strip_push_pixel_front(dotstar_t * strip, uint8_t r, uint8_t g, uint8_t b, uint8_t brightness);
+void dotstar_h_strip_push_pixel_back(dotstar_t * strip, uint8_t r, uint8_t g, uint8_t b, uint8_t brightness);
+void dotstar_h_strip_rotate_left(dotstar_t * strip);
+void dotstar_h_strip_rotate_right(dotstar_t * strip);
+
 #endif
@@ -0,0 +1,247 @@
+/*!
+ *	@file		dotstar_anim.c
+ *	@author		BCA
+ *	@version	1.0.0
+ *	@date		12/2/16
+ *	@brief		Source for Dotstar animation scheduler
+ *	@copyright	 Bay Computer Associates, Incorporated 2016
+				All rights reserved
+				This file contains CONFIDENTIAL material
+ *	@remark		Matilda USPS Blue Box
+ *	@Repository URL: $HeadURL: $
+ *	Last changed by: $Author: $
+ *	Last changed on: $Date: $
+ *	Revision:		$Rev: $
+**/
+
+#include "dotstar_anim.h"
+#include "dotstar_kernels.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h> // for memset, memcpy
+#include <unistd.h> // for read, close
+#include <errno.h>
+#include <time.h>
+#include <sys/timerfd.h>
+
+#define NSEC_PER_SEC 1000000000ULL
+
+static uint64_t timespec_ns(const struct timespec * t)
+{
+    return (uint64_t)t->tv_sec * NSEC_PER_SEC + t->tv_nsec;
+}
+
+int dotstar_anim_run(dotstar_t * strip,
+                     uint32_t fps,
+                     uint32_t frames,
+                     dotstar_anim_render render,
+                     void * arg,
+                     dotstar_anim_stats * stats)
+{
+    dotstar_anim_stats local;
+    struct itimerspec spec;
+    struct timespec now;
+    uint64_t jitter_total_us = 0;
+    uint64_t ticks = 0;
+
+    if (stats == NULL) {
+        stats = &local;
+    }
+    memset(stats, 0, sizeof(*stats));
+
+    if (fps == 0) {
+        printf("Enter a value > 0 for the frame rate.\n");
+        return -1;
+    }
+
+    int fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    if (fd < 0) {
+        printf("Can't create animation timer.\n");
+        return -1;
+    }
+
+    // The first deadline is one period from now and the rest follow at
+    // fixed offsets from it.
+    uint64_t period = NSEC_PER_SEC / fps;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    uint64_t start = timespec_ns(&now) + period;
+
+    spec.it_value.tv_sec = start / NSEC_PER_SEC;
+    spec.it_value.tv_nsec = start % NSEC_PER_SEC;
+    spec.it_interval.tv_sec = period / NSEC_PER_SEC;
+    spec.it_interval.tv_nsec = period % NSEC_PER_SEC;
+    if (timerfd_settime(fd, TFD_TIMER_ABSTIME, &spec, NULL) < 0) {
+        printf("Can't start animation timer.\n");
+        close(fd);
+        return -1;
+    }
+
+    while (frames == 0 || ticks < frames) {
+        uint64_t expirations;
+
+        if (read(fd, &expirations, sizeof(expirations)) != sizeof(expirations)) {
+            if (errno == EINTR) {
+                continue;
+            }
+            printf("Can't read animation timer.\n");
+            close(fd);
+            return -1;
+        }
+
+        // More than one expiration means the previous frame ran past the
+        // deadlines in between. Render the latest one only.
+        ticks += expirations;
+        if (frames != 0 && ticks > frames) {
+            expirations -= ticks - frames;
+            ticks = frames;
+        }
+        stats->frames_skipped += expirations - 1;
+        uint32_t frame = ticks - 1;
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        uint64_t now_ns = timespec_ns(&now);
+        uint64_t deadline = start + frame * period;
+        uint32_t late_us = (now_ns > deadline) ? (now_ns - deadline) / 1000 : 0;
+        if (late_us > stats->jitter_max_us) {
+            stats->jitter_max_us = late_us;
+        }
+
+        if (render(strip, frame, arg) != 0) {
+            break;
+        }
+        dotstar_h_show(strip);
+
+        stats->frames_shown++;
+        jitter_total_us += late_us;
+        stats->jitter_mean_us = jitter_total_us / stats->frames_shown;
+    }
+
+    close(fd);
+    return 0;
+}
+
+int dotstar_effect_rotate(dotstar_t * strip, uint32_t frame, void * arg)
+{
+    dotstar_effect_rotate_t *effect = (dotstar_effect_rotate_t *) arg;
+    uint32_t k = frame % (2 * effect->span);
+    uint32_t target = (k < effect->span) ? k + 1 : 2 * effect->span - k - 1;
+
+    // Catch up on skipped frames as well.
+    while (effect->position < target) {
+        dotstar_h_strip_rotate_right(strip);
+        effect->position++;
+    }
+    while (effect->position > target) {
+        dotstar_h_strip_rotate_left(strip);
+        effect->position--;
+    }
+    return 0;
+}
+
+int dotstar_effect_fade(dotstar_t * strip, uint32_t frame, void * arg)
+{
+    dotstar_effect_fade_t *effect = (dotstar_effect_fade_t *) arg;
+    uint32_t ramp = (255 + effect->step) / effect->step;
+    uint32_t k = frame % (2 * ramp);
+    uint32_t level = (k < ramp) ? k * effect->step : 255 - (k - ramp) * effect->step;
+
+    dotstar_h_set_strip(strip,
+                        (effect->r * level + 127) / 255,
+                        (effect->g * level + 127) / 255,
+                        (effect->b * level + 127) / 255,
+                        effect->brightness);
+    return 0;
+}
+
+int dotstar_transition_begin(dotstar_transition_t * transition,
+                             dotstar_t * strip,
+                             dotstar_transition_type type,
+                             const uint32_t * target,
+                             uint32_t duration_ms,
+                             uint32_t fps)
+{
+    uint32_t count = dotstar_h_num_leds(strip);
+
+    memset(transition, 0, sizeof(*transition));
+    transition->type = type;
+    transition->count = count;
+    transition->frames = (uint64_t)duration_ms * fps / 1000;
+    if (transition->frames == 0) {
+        transition->frames = 1;
+    }
+
+    transition->from = (uint32_t *) malloc(count * 4);
+    transition->to = (uint32_t *) malloc(count * 4);
+    transition->out = (uint32_t *) malloc(count * 4);
+    transition->key = (uint8_t *) malloc(count);
+    if (transition->from == NULL || transition->to == NULL ||
+        transition->out == NULL || transition->key == NULL) {
+        dotstar_transition_end(transition);
+        return -1;
+    }
+
+    dotstar_h_get_pixels_packed(strip, 0, count, transition->from);
+    memcpy(transition->to, target, count * 4);
+
+    // Spread the keys evenly over 0-255 and shuffle them, so about the same
+    // number of pixels switch on every frame of a dissolve.
+    uint32_t seed = 0x9E3779B9u ^ count;
+    for (uint32_t i = 0; i < count; i++) {
+        transition->key[i] = (uint8_t)(((uint64_t)i * 256) / count);
+    }
+    for (uint32_t i = count; i > 1; i--) {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        uint32_t j = seed % i;
+        uint8_t k = transition->key[i - 1];
+        transition->key[i - 1] = transition->key[j];
+        transition->key[j] = k;
+    }
+    return 0;
+}
+
+void dotstar_transition_end(dotstar_transition_t * transition)
+{
+    free(transition->from);
+    free(transition->to);
+    free(transition->out);
+    free(transition->key);
+    memset(transition, 0, sizeof(*transition));
+}
+
+int dotstar_transition_render(dotstar_t * strip, uint32_t frame, void * arg)
+{
+    dotstar_transition_t *t = (dotstar_transition_t *) arg;
+
+    if (frame >= t->frames) {
+        return 1;
+    }
+
+    // Progress 0 to 256, reaching 256 on the last frame.
+    uint16_t weight = ((uint64_t)(frame + 1) * 256) / t->frames;
+
+    switch (t->type) {
+    case DOTSTAR_TRANSITION_CROSSFADE:
+        dotstar_kernels->lerp(t->out, t->from, t->to, t->count, weight);
+        dotstar_h_set_pixels_packed(strip, 0, t->count, t->out);
+        break;
+    case DOTSTAR_TRANSITION_WIPE: {
+        // Edge position in 1/256 pixels. The pixel under the edge is faded.
+        uint64_t edge = ((uint64_t)(frame + 1) * t->count * 256) / t->frames;
+        uint32_t full = edge >> 8;
+        dotstar_h_set_pixels_packed(strip, 0, full, t->to);
+        if (full < t->count) {
+            dotstar_kernels->lerp(t->out, &t->from[full], &t->to[full], 1, edge & 0xFF);
+            dotstar_h_set_pixels_packed(strip, full, 1, t->out);
+            dotstar_h_set_pixels_packed(strip, full + 1, t->count - full - 1, &t->from[full + 1]);
+        }
+        break;
+    }
+    case DOTSTAR_TRANSITION_DISSOLVE:
+        dotstar_kernels->select(t->out, t->from, t->to, t->key, t->count, weight);
+        dotstar_h_set_pixels_packed(strip, 0, t->count, t->out);
+        break;
+    }
+    return 0;
+}
@@ -0,0 +1,150 @@
+/*!
+ *	@file		dotstar_anim.h
+ *	@author		BCA
+ *	@version	1.0.0
+ *	@date		12/2/16
+ *	@brief		Header for Dotstar animation scheduler
+ *	@copyright	 Bay Computer Associates, Incorporated 2016
+				All rights reserved
+				This file contains CONFIDENTIAL material
+ *	@remark		Matilda USPS Blue Box
+ *	@Repository URL: $HeadURL: $
+ *	Last changed by: $Author: $
+ *	Last changed on: $Date: $
+ *	Revision:		$Rev: $
+**/
+#ifndef DOTSTAR_ANIM_H
+#define DOTSTAR_ANIM_H
+
+#include "dotstar.h"
+
+#include <stdint.h>
+
+/*
+@brief Render one frame of an animation into the strip buffer.
+
+@param strip  The strip being animated
+@param frame  The frame number, starting at 0. Frames the scheduler had to
+              skip are not rendered, so an effect should derive its state
+              from the frame number rather than count calls.
+@param arg  The argument given to dotstar_anim_run()
+@return 0 to continue, nonzero to stop the animation
+*/
+typedef int (*dotstar_anim_render)(dotstar_t * strip, uint32_t frame, void * arg);
+
+/*
+@brief Timing of an animation. Jitter is how late the frame was rendered
+       relative to its deadline.
+*/
+typedef struct {
+    uint32_t frames_shown;
+    uint32_t frames_skipped;    // Deadlines missed because a frame ran late
+    uint32_t jitter_max_us;
+    uint32_t jitter_mean_us;
+} dotstar_anim_stats;
+
+/*
+@brief Run an animation at a fixed frame rate. Frame deadlines are absolute
+       times on CLOCK_MONOTONIC, so the rate does not drift with render or
+       transfer time. When a frame runs past one or more deadlines those
+       frames are skipped and the animation continues on schedule. Blocks
+       until the animation ends.
+
+@param strip  The strip to animate
+@param fps  Frames per second. Must be > 0.
+@param frames  The number of frames to run, or 0 to run until render
+               returns nonzero
+@param render  Called before each frame is shown
+@param arg  Passed to render
+@param stats  Receives the timing of the animation. May be NULL.
+@return 0 on success, nonzero if the timer could not be set up
+*/
+int dotstar_anim_run(dotstar_t * strip,
+                     uint32_t fps,
+                     uint32_t frames,
+                     dotstar_anim_render render,
+                     void * arg,
+                     dotstar_anim_stats * stats);
+
+/*
+@brief Built-in effect that rotates the strip right by span pixels, one per
+       frame, then back left again. Use dotstar_effect_rotate() as the render
+       function and a dotstar_effect_rotate_t as its argument.
+*/
+typedef struct {
+    uint32_t span;      // Pixels to travel in each direction. Must be > 0.
+    uint32_t position;  // Current offset. Set to 0 before starting.
+} dotstar_effect_rotate_t;
+
+int dotstar_effect_rotate(dotstar_t * strip, uint32_t frame, void * arg);
+
+/*
+@brief Built-in effect that fades the whole strip from off up to a color and
+       back down, step levels per frame. Use dotstar_effect_fade() as the
+       render function and a dotstar_effect_fade_t as its argument.
+*/
+typedef struct {
+    uint8_t r;
+    uint8_t g;
+    uint8_t b;
+    uint8_t brightness;
+    uint8_t step;       // Level change per frame, 0-255 scale. Must be > 0.
+} dotstar_effect_fade_t;
+
+int dotstar_effect_fade(dotstar_t * strip, uint32_t frame, void * arg);
+
+/*
+@brief Transition from the frame in the strip buffer to a target frame. Set
+       one up with dotstar_transition_begin(), run it with
+       dotstar_transition_render() as the render function and the
+       dotstar_transition_t as its argument, then free it with
+       dotstar_transition_end(). All math is 8-bit fixed point in the pixel
+       kernels.
+*/
+typedef enum {
+    DOTSTAR_TRANSITION_CROSSFADE,   // Every pixel fades to the target
+    DOTSTAR_TRANSITION_WIPE,        // The target slides in from pixel 0 with a soft edge
+    DOTSTAR_TRANSITION_DISSOLVE     // Pixels switch to the target in random order
+} dotstar_transition_type;
+
+typedef struct {
+    dotstar_transition_type type;
+    uint32_t frames;    // Length of the transition. Pass to dotstar_anim_run().
+    uint32_t count;     // Pixels in the strip
+    uint32_t * from;    // Strip buffer when the transition began
+    uint32_t * to;      // Target frame
+    uint32_t * out;     // Work buffer
+    uint8_t * key;      // Dissolve order, one byte per pixel
+} dotstar_transition_t;
+
+/*
+@brief Set up a transition.
+
+@param transition  Receives the transition
+@param strip  The strip. Its current buffer is the starting frame.
+@param type  The kind of transition
+@param target  The target frame, dotstar_h_num_leds() pixels in the strip
+               wire format (see dotstar_set_pixels_packed()). It is copied.
+@param duration_ms  How long the transition takes
+@param fps  The frame rate it will run at
+@return 0 on success, nonzero if the buffers can't be allocated
+*/
+int dotstar_transition_begin(dotstar_transition_t * transition,
+                             dotstar_t * strip,
+                             dotstar_transition_type type,
+                             const uint32_t * target,
+                             uint32_t duration_ms,
+                             uint32_t fps);
+
+/*
+@brief Free a transition's buffers.
+*/
+void dotstar_transition_end(dotstar_transition_t * transition);
+
+/*
+@brief Render function that draws frame of the transition. The last frame
+       is exactly the target. Ends the animation after it.
+*/
+int dotstar_transition_render(dotstar_t * strip, uint32_t frame, void * arg);
+
+#endif
@@ -0,0 +1,77 @@
+/*!
+ *	@file		dotstar_chipset.h
+ *	@author		BCA
+ *	@version	1.0.0
+ *	@date		12/2/16
+ *	@brief		Header for Dotstar chipset encoders
+ *	@copyright	 Bay Computer Associates, Incorporated 2016
+				All rights reserved
+				This file contains CONFIDENTIAL material
+ *	@remark		Matilda USPS Blue Box
+ *	@Repository URL: $HeadURL: $
+ *	Last changed by: $Author: $
+ *	Last changed on: $Date: $
+ *	Revision:		$Rev: $
+**/
+#ifndef DOTSTAR_CHIPSET_H
+#define DOTSTAR_CHIPSET_H
+
+#include "ProjectConfig.h"
+
+/*
+Every pixel is 4 bytes on the wire. Byte 0 is the start bits ORed with the
+5-bit global brightness, and bytes 1 to 3 hold the colors in the order given
+by the red, green and blue byte numbers below. All chipsets in the list share
+this 5-bit field (0 to 31, of which the driver uses 0 to PIXEL_MAX_BRIGHTNESS),
+so the list has no brightness column. Only the light output differs, as below.
+
+After the pixels, every chipset needs numLEDs/2 more clock edges to shift the
+last pixel through, sent as footer bytes. The SK9822 also needs a 32-bit
+reset frame of zeros before them. Without it, that chip shows new global
+brightness values one frame late. It also drives its brightness as LED
+current rather than as a slow PWM, so the same brightness value looks
+different on the two chips. dotstar_show() picks the lowest brightness that
+reaches each pixel's color, which suits both.
+
+The chipset is picked at build time with DOTSTAR_CHIPSET in ProjectConfig.h.
+Its values are compile-time constants, so every pixel loop is specialized
+for it.
+*/
+
+//DOTSTAR_CHIPSET_(tag, redByte, greenByte, blueByte, startBits, footerByte, resetBytes)
+#define DOTSTAR_CHIPSET_LIST \
+DOTSTAR_CHIPSET_(APA102_BGR	,3	,2	,1	,0xE0	,0xFF	,0	) \
+DOTSTAR_CHIPSET_(APA102_RGB	,1	,2	,3	,0xE0	,0xFF	,0	) \
+DOTSTAR_CHIPSET_(APA102_GRB	,2	,1	,3	,0xE0	,0xFF	,0	) \
+DOTSTAR_CHIPSET_(SK9822_BGR	,3	,2	,1	,0xE0	,0x00	,4	) \
+DOTSTAR_CHIPSET_(SK9822_RGB	,1	,2	,3	,0xE0	,0x00	,4	) \
+//Comment terminates list macro. Do not delete.
+
+enum
+{
+#define DOTSTAR_CHIPSET_(tag, redByte, greenByte, blueByte, startBits, footerByte, resetBytes) \
+	DOTSTAR_CHIPSET_##tag##_RED = redByte, \
+	DOTSTAR_CHIPSET_##tag##_GREEN = greenByte, \
+	DOTSTAR_CHIPSET_##tag##_BLUE = blueByte, \
+	DOTSTAR_CHIPSET_##tag##_START = startBits, \
+	DOTSTAR_CHIPSET_##tag##_FOOTER = footerByte, \
+	DOTSTAR_CHIPSET_##tag##_RESET = resetBytes,
+	DOTSTAR_CHIPSET_LIST
+#undef DOTSTAR_CHIPSET_
+};
+
+#define DOTSTAR_CHIPSET_VALUE_(tag, field) DOTSTAR_CHIPSET_##tag##_##field
+#define DOTSTAR_CHIPSET_VALUE(tag, field) DOTSTAR_CHIPSET_VALUE_(tag, field)
+#define DOTSTAR_CHIPSET_NAME_(tag) #tag
+#define DOTSTAR_CHIPSET_NAME_OF(tag) DOTSTAR_CHIPSET_NAME_(tag)
+
+// Values for the chipset of this build.
+#define DOTSTAR_RED_BYTE	DOTSTAR_CHIPSET_VALUE(DOTSTAR_CHIPSET, RED)
+#define DOTSTAR_GREEN_BYTE	DOTSTAR_CHIPSET_VALUE(DOTSTAR_CHIPSET, GREEN)
+#define DOTSTAR_BLUE_BYTE	DOTSTAR_CHIPSET_VALUE(DOTSTAR_CHIPSET, BLUE)
+#define DOTSTAR_START_BITS	DOTSTAR_CHIPSET_VALUE(DOTSTAR_CHIPSET, START)
+#define DOTSTAR_FOOTER_BYTE	DOTSTAR_CHIPSET_VALUE(DOTSTAR_CHIPSET, FOOTER)
+#define DOTSTAR_RESET_BYTES	DOTSTAR_CHIPSET_VALUE(DOTSTAR_CHIPSET, RESET)
+#define DOTSTAR_CHIPSET_NAME	DOTSTAR_CHIPSET_NAME_OF(DOTSTAR_CHIPSET)
+
+#endif
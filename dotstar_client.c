@@ -0,0 +1,194 @@
+/*!
+ *	@file		dotstar_client.c
+ *	@author		BCA
+ *	@version	1.0.0
+ *	@date		12/2/16
+ *	@brief		Source for the Dotstar shared-memory frame client
+ *	@copyright	 Bay Computer Associates, Incorporated 2016
+				All rights reserved
+				This file contains CONFIDENTIAL material
+ *	@remark		Matilda USPS Blue Box
+ *	@Repository URL: $HeadURL: $
+ *	Last changed by: $Author: $
+ *	Last changed on: $Date: $
+ *	Revision:		$Rev: $
+**/
+
+#include "dotstar_client.h"
+#include "dotstar_shm.h"
+#include <stdlib.h>
+#include <string.h> // for memcpy, memset
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+struct dotstar_client {
+    dotstar_shm_header * header;
+    size_t size;
+    int32_t slot;           // Claimed slot, or -1
+    uint32_t next;          // Where to start looking for a free slot
+};
+
+dotstar_client_t * dotstar_client_open(const char * name)
+{
+    struct stat st;
+
+    if (name == NULL) {
+        name = DOTSTAR_SHM_NAME;
+    }
+
+    int fd = shm_open(name, O_RDWR | O_CLOEXEC, 0);
+    if (fd < 0) {
+        return NULL;
+    }
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(dotstar_shm_header)) {
+        close(fd);
+        return NULL;
+    }
+    void *data = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return NULL;
+    }
+
+    dotstar_shm_header *header = (dotstar_shm_header *) data;
+    if (__atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) != DOTSTAR_SHM_MAGIC ||
+        header->version != DOTSTAR_SHM_VERSION ||
+        header->slot_stride < header->num_leds * sizeof(dotstar_rgbb) ||
+        header->slot_offset < sizeof(dotstar_shm_header) + header->num_slots * sizeof(dotstar_shm_slot) ||
+        header->slot_offset + (uint64_t)header->num_slots * header->slot_stride > (uint64_t)st.st_size) {
+        munmap(data, st.st_size);
+        return NULL;
+    }
+
+    dotstar_client_t *client = (dotstar_client_t *) calloc(1, sizeof(dotstar_client_t));
+    if (client == NULL) {
+        munmap(data, st.st_size);
+        return NULL;
+    }
+    client->header = header;
+    client->size = st.st_size;
+    client->slot = -1;
+    return client;
+}
+
+void dotstar_client_close(dotstar_client_t * client)
+{
+    if (client == NULL) {
+        return;
+    }
+    if (client->slot >= 0) {
+        dotstar_shm_slot *slot = &dotstar_shm_slots(client->header)[client->slot];
+        __atomic_store_n(&slot->owner, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&slot->state, DOTSTAR_SHM_FREE, __ATOMIC_RELEASE);
+    }
+    munmap(client->header, client->size);
+    free(client);
+}
+
+uint32_t dotstar_client_num_leds(const dotstar_client_t * client)
+{
+    return client->header->num_leds;
+}
+
+// Take a slot and record this process as its owner, so the server can free
+// the slot if the process dies before submitting.
+static int dotstar_client_claim(dotstar_client_t * client, uint32_t slot, uint32_t from)
+{
+    dotstar_shm_slot *s = &dotstar_shm_slots(client->header)[slot];
+
+    if (!__atomic_compare_exchange_n(&s->state, &from, DOTSTAR_SHM_WRITING, 0,
+                                     __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        return 0;
+    }
+    __atomic_store_n(&s->owner, (uint32_t)getpid(), __ATOMIC_RELAXED);
+    return 1;
+}
+
+dotstar_rgbb * dotstar_client_begin_frame(dotstar_client_t * client)
+{
+    dotstar_shm_header *header = client->header;
+    dotstar_shm_slot *slots = dotstar_shm_slots(header);
+
+    if (client->slot >= 0) {
+        return dotstar_shm_frame(header, client->slot);
+    }
+
+    for (uint32_t n = 0; n < header->num_slots; n++) {
+        uint32_t i = (client->next + n) % header->num_slots;
+        if (dotstar_client_claim(client, i, DOTSTAR_SHM_FREE)) {
+            client->slot = i;
+            client->next = i + 1;
+            return dotstar_shm_frame(header, i);
+        }
+    }
+
+    // No free slot, so the server is behind. Replace the oldest frame it has
+    // not taken yet.
+    for (;;) {
+        int32_t oldest = -1;
+        uint32_t oldest_seq = 0;
+        for (uint32_t i = 0; i < header->num_slots; i++) {
+            if (__atomic_load_n(&slots[i].state, __ATOMIC_ACQUIRE) == DOTSTAR_SHM_READY) {
+                uint32_t seq = __atomic_load_n(&slots[i].seq, __ATOMIC_RELAXED);
+                if (oldest < 0 || (int32_t)(seq - oldest_seq) < 0) {
+                    oldest = i;
+                    oldest_seq = seq;
+                }
+            }
+        }
+        if (oldest < 0) {
+            return NULL;
+        }
+        if (dotstar_client_claim(client, oldest, DOTSTAR_SHM_READY)) {
+            __atomic_add_fetch(&header->frames_dropped, 1, __ATOMIC_RELAXED);
+            client->slot = oldest;
+            return dotstar_shm_frame(header, oldest);
+        }
+    }
+}
+
+int dotstar_client_submit(dotstar_client_t * client)
+{
+    dotstar_shm_header *header = client->header;
+
+    if (client->slot < 0) {
+        return -1;
+    }
+
+    dotstar_shm_slot *slot = &dotstar_shm_slots(header)[client->slot];
+    __atomic_store_n(&slot->seq, __atomic_add_fetch(&header->doorbell, 1, __ATOMIC_ACQ_REL),
+                     __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->owner, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->state, DOTSTAR_SHM_READY, __ATOMIC_RELEASE);
+    client->slot = -1;
+
+    dotstar_shm_wake(&header->doorbell);
+    return 0;
+}
+
+int dotstar_client_show(dotstar_client_t * client, const dotstar_rgbb * pixels, uint32_t count)
+{
+    uint32_t num_leds = client->header->num_leds;
+    dotstar_rgbb *frame = dotstar_client_begin_frame(client);
+
+    if (frame == NULL) {
+        return -1;
+    }
+    if (count > num_leds) {
+        count = num_leds;
+    }
+    memcpy(frame, pixels, count * sizeof(dotstar_rgbb));
+    memset(&frame[count], 0, (num_leds - count) * sizeof(dotstar_rgbb));
+    return dotstar_client_submit(client);
+}
+
+uint32_t dotstar_client_get_shown_frames(const dotstar_client_t * client)
+{
+    return __atomic_load_n(&client->header->frames_shown, __ATOMIC_RELAXED);
+}
+
+uint32_t dotstar_client_get_dropped_frames(const dotstar_client_t * client)
+{
+    return __atomic_load_n(&client->header->frames_dropped, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,77 @@
+/*!
+ *	@file		dotstar_client.h
+ *	@author		BCA
+ *	@version	1.0.0
+ *	@date		12/2/16
+ *	@brief		Header for the Dotstar shared-memory frame client
+ *	@copyright	 Bay Computer Associates, Incorporated 2016
+				All rights reserved
+				This file contains CONFIDENTIAL material
+ *	@remark		Matilda USPS Blue Box
+ *	@Repository URL: $HeadURL: $
+ *	Last changed by: $Author: $
+ *	Last changed on: $Date: $
+ *	Revision:		$Rev: $
+**/
+#ifndef DOTSTAR_CLIENT_H
+#define DOTSTAR_CLIENT_H
+
+#include "dotstar.h"
+
+#include <stdint.h>
+
+/*
+Client side of the frame server in dotstar_server.h. Any number of processes
+and threads may be clients. A client handle is used by one thread at a time.
+
+The functions only take handles, plain integers and pixel pointers, so the
+shared library built with make libdotstar_client.so can be loaded from
+Python with ctypes. A pixel is 4 bytes: red, green, blue, brightness.
+*/
+
+typedef struct dotstar_client dotstar_client_t;
+
+/*
+@brief Map a running server's shared memory.
+
+@param name  The shared memory object name, or NULL for DOTSTAR_SHM_NAME
+@return the client, or NULL if there is no server
+*/
+dotstar_client_t * dotstar_client_open(const char * name);
+
+/*
+@brief Unmap. A frame claimed but not submitted is dropped.
+*/
+void dotstar_client_close(dotstar_client_t * client);
+
+uint32_t dotstar_client_num_leds(const dotstar_client_t * client);
+
+/*
+@brief Claim a frame to draw into. The frame is in shared memory, so drawing
+       into it is the only copy. It holds the last frame submitted through
+       this slot, not necessarily the one on the strip.
+
+@return the frame, dotstar_client_num_leds() pixels, or NULL if every slot
+        is busy
+*/
+dotstar_rgbb * dotstar_client_begin_frame(dotstar_client_t * client);
+
+/*
+@brief Publish the claimed frame and wake the server.
+
+@return 0 on success, nonzero if no frame was claimed
+*/
+int dotstar_client_submit(dotstar_client_t * client);
+
+/*
+@brief Claim a frame, copy pixels into it and publish it. Pixels past count
+       are black.
+
+@return 0 on success, nonzero if every slot is busy
+*/
+int dotstar_client_show(dotstar_client_t * client, const dotstar_rgbb * pixels, uint32_t count);
+
+uint32_t dotstar_client_get_shown_frames(const dotstar_client_t * client);
+uint32_t dotstar_client_get_dropped_frames(const dotstar_client_t * client);
+
+#endif
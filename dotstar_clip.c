@@ -0,0 +1,221 @@
+/*!
+ *	@file		dotstar_clip.c
+ *	@author		BCA
+ *	@version	1.0.0
+ *	@date		12/2/16
+ *	@brief		Source for Dotstar animation clips
+ *	@copyright	 Bay Computer Associates, Incorporated 2016
+				All rights reserved
+				This file contains CONFIDENTIAL material
+ *	@remark		Matilda USPS Blue Box
+ *	@Repository URL: $HeadURL: $
+ *	Last changed by: $Author: $
+ *	Last changed on: $Date: $
+ *	Revision:		$Rev: $
+**/
+
+#include "dotstar_clip.h"
+#include <stdio.h>
+#include <string.h> // for memset
+#include <fcntl.h>
+#include <unistd.h> // for close
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Pixels set per call when expanding a fill run.
+#define DOTSTAR_CLIP_FILL_CHUNK 64
+
+static const dotstar_clip_frame * dotstar_clip_frame_at(const dotstar_clip * clip, uint32_t frame)
+{
+    return (const dotstar_clip_frame *)(clip->data + clip->index[frame]);
+}
+
+// Check that a frame and all of its runs lie inside the file and the strip.
+static int dotstar_clip_check_frame(const dotstar_clip * clip, uint32_t frame)
+{
+    uint64_t offset = clip->index[frame];
+
+    if ((offset & 3) != 0 || offset + sizeof(dotstar_clip_frame) > clip->size) {
+        return -1;
+    }
+
+    const dotstar_clip_frame *hdr = dotstar_clip_frame_at(clip, frame);
+    uint64_t end = offset + sizeof(dotstar_clip_frame) + hdr->size;
+    if (end > clip->size || (hdr->type != DOTSTAR_CLIP_KEY && hdr->type != DOTSTAR_CLIP_DELTA) ||
+        (frame == 0 && hdr->type != DOTSTAR_CLIP_KEY)) {
+        return -1;
+    }
+
+    offset += sizeof(dotstar_clip_frame);
+    for (uint32_t i = 0; i < hdr->num_runs; i++) {
+        if (offset + sizeof(dotstar_clip_run) > end) {
+            return -1;
+        }
+        const dotstar_clip_run *run = (const dotstar_clip_run *)(clip->data + offset);
+        uint64_t pixels;
+        if (run->type == DOTSTAR_CLIP_RUN_COPY) {
+            pixels = run->count;
+        } else if (run->type == DOTSTAR_CLIP_RUN_FILL) {
+            pixels = 1;
+        } else {
+            return -1;
+        }
+        if ((uint64_t)run->offset + run->count > clip->header->num_leds) {
+            return -1;
+        }
+        offset += sizeof(dotstar_clip_run) + pixels * sizeof(dotstar_rgbb);
+    }
+    return (offset == end) ? 0 : -1;
+}
+
+int dotstar_clip_open(dotstar_clip * clip, const char * path)
+{
+    struct stat st;
+
+    memset(clip, 0, sizeof(*clip));
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        printf("Can't open clip.\n");
+        return -1;
+    }
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(dotstar_clip_header)) {
+        printf("Clip is too short.\n");
+        close(fd);
+        return -1;
+    }
+
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        printf("Can't map clip.\n");
+        return -1;
+    }
+
+    clip->data = (const uint8_t *) data;
+    clip->size = st.st_size;
+    clip->header = (const dotstar_clip_header *) data;
+
+    const dotstar_clip_header *header = clip->header;
+    uint64_t index_end = (uint64_t)header->index_offset + (uint64_t)header->num_frames * 4;
+    if (header->magic != DOTSTAR_CLIP_MAGIC || header->version != DOTSTAR_CLIP_VERSION ||
+        header->header_size != sizeof(dotstar_clip_header) || header->num_frames == 0 ||
+        header->fps == 0 || (header->index_offset & 3) != 0 || index_end > clip->size) {
+        printf("Not a valid clip.\n");
+        dotstar_clip_close(clip);
+        return -1;
+    }
+    clip->index = (const uint32_t *)(clip->data + header->index_offset);
+
+    for (uint32_t i = 0; i < header->num_frames; i++) {
+        if (dotstar_clip_check_frame(clip, i) != 0) {
+            printf("Clip frame %u is not valid.\n", i);
+            dotstar_clip_close(clip);
+            return -1;
+        }
+    }
+
+    madvise(data, clip->size, MADV_SEQUENTIAL);
+    return 0;
+}
+
+void dotstar_clip_close(dotstar_clip * clip)
+{
+    if (clip->data != NULL) {
+        munmap((void *) clip->data, clip->size);
+    }
+    memset(clip, 0, sizeof(*clip));
+}
+
+uint32_t dotstar_clip_num_frames(const dotstar_clip * clip)
+{
+    return (clip->header != NULL) ? clip->header->num_frames : 0;
+}
+
+uint32_t dotstar_clip_fps(const dotstar_clip * clip)
+{
+    return (clip->header != NULL) ? clip->header->fps : 0;
+}
+
+static void dotstar_clip_fill(dotstar_t * strip, uint32_t offset, uint32_t count, dotstar_rgbb pixel)
+{
+    dotstar_rgbb chunk[DOTSTAR_CLIP_FILL_CHUNK];
+    uint32_t n = (count < DOTSTAR_CLIP_FILL_CHUNK) ? count : DOTSTAR_CLIP_FILL_CHUNK;
+
+    for (uint32_t i = 0; i < n; i++) {
+        chunk[i] = pixel;
+    }
+    for (; count > 0; offset += n, count -= n) {
+        if (n > count) {
+            n = count;
+        }
+        dotstar_h_set_pixels(strip, offset, n, chunk);
+    }
+}
+
+static void dotstar_clip_apply(const dotstar_clip * clip, dotstar_t * strip, uint32_t frame)
+{
+    const dotstar_clip_frame *hdr = dotstar_clip_frame_at(clip, frame);
+    const uint8_t *ptr = (const uint8_t *)(hdr + 1);
+
+    if (hdr->type == DOTSTAR_CLIP_KEY) {
+        dotstar_h_set_strip(strip, 0, 0, 0, 0);
+    }
+
+    for (uint32_t i = 0; i < hdr->num_runs; i++) {
+        const dotstar_clip_run *run = (const dotstar_clip_run *) ptr;
+        const dotstar_rgbb *pixels = (const dotstar_rgbb *)(run + 1);
+
+        if (run->type == DOTSTAR_CLIP_RUN_COPY) {
+            dotstar_h_set_pixels(strip, run->offset, run->count, pixels);
+            ptr = (const uint8_t *)(pixels + run->count);
+        } else {
+            dotstar_clip_fill(strip, run->offset, run->count, pixels[0]);
+            ptr = (const uint8_t *)(pixels + 1);
+        }
+    }
+}
+
+int dotstar_clip_decode(dotstar_clip * clip, dotstar_t * strip, uint32_t frame)
+{
+    if (frame >= dotstar_clip_num_frames(clip)) {
+        return -1;
+    }
+    // The runs were only checked against the clip's own length.
+    if (clip->header->num_leds != dotstar_h_num_leds(strip)) {
+        printf("Clip is for %u LEDs, strip has %u.\n", clip->header->num_leds,
+               dotstar_h_num_leds(strip));
+        return -1;
+    }
+
+    // Playing forward, the next frame is one delta on top of the last.
+    if (frame == clip->next_frame) {
+        dotstar_clip_apply(clip, strip, frame);
+        clip->next_frame = frame + 1;
+        return 0;
+    }
+
+    // Seeking. Start from the key frame at or before frame, or carry on from
+    // the last decoded frame if no key frame comes after it.
+    uint32_t last = (clip->next_frame <= frame) ? clip->next_frame : 0;
+    uint32_t first = frame;
+    while (first > last && dotstar_clip_frame_at(clip, first)->type != DOTSTAR_CLIP_KEY) {
+        first--;
+    }
+
+    for (uint32_t i = first; i <= frame; i++) {
+        dotstar_clip_apply(clip, strip, i);
+    }
+    clip->next_frame = frame + 1;
+    return 0;
+}
+
+void dotstar_clip_rewind(dotstar_clip * clip)
+{
+    clip->next_frame = 0;
+}
+
+int dotstar_clip_render(dotstar_t * strip, uint32_t frame, void * arg)
+{
+    return dotstar_clip_decode((dotstar_clip *) arg, strip, frame);
+}
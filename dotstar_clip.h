@@ -0,0 +1,132 @@
+/*!
+ *	@file		dotstar_clip.h
+ *	@author		BCA
+ *	@version	1.0.0
+ *	@date		12/2/16
+ *	@brief		Header for Dotstar animation clips
+ *	@copyright	 Bay Computer Associates, Incorporated 2016
+				All rights reserved
+				This file contains CONFIDENTIAL material
+ *	@remark		Matilda USPS Blue Box
+ *	@Repository URL: $HeadURL: $
+ *	Last changed by: $Author: $
+ *	Last changed on: $Date: $
+ *	Revision:		$Rev: $
+**/
+#ifndef DOTSTAR_CLIP_H
+#define DOTSTAR_CLIP_H
+
+#include "dotstar.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+A clip is a prebuilt animation in a file. clipgen builds one from raw frames.
+
+All fields are little-endian and every record is a multiple of 4 bytes, so
+the player reads the file in place through mmap. The layout is:
+
+    dotstar_clip_header
+    frames, each a dotstar_clip_frame followed by its runs
+    index: num_frames uint32_t file offsets, one per frame
+
+A run is a dotstar_clip_run followed by its pixels as dotstar_rgbb. A copy
+run has count pixels. A fill run has one pixel, repeated count times.
+
+A key frame starts from a black strip with brightness 0 and applies its runs.
+A delta frame applies its runs to the previous frame. Frame 0 must be a key
+frame. Key frames let the player seek without decoding the whole clip.
+*/
+
+#define DOTSTAR_CLIP_MAGIC 0x4C435344u     // "DSCL"
+#define DOTSTAR_CLIP_VERSION 1
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t header_size;       // sizeof(dotstar_clip_header)
+    uint32_t num_leds;
+    uint32_t num_frames;
+    uint32_t fps;
+    uint32_t index_offset;
+} dotstar_clip_header;
+
+typedef enum {
+    DOTSTAR_CLIP_KEY = 0,
+    DOTSTAR_CLIP_DELTA = 1
+} dotstar_clip_frame_type;
+
+typedef struct {
+    uint16_t type;              // dotstar_clip_frame_type
+    uint16_t num_runs;
+    uint32_t size;              // Bytes of runs that follow
+} dotstar_clip_frame;
+
+typedef enum {
+    DOTSTAR_CLIP_RUN_COPY = 0,
+    DOTSTAR_CLIP_RUN_FILL = 1
+} dotstar_clip_run_type;
+
+typedef struct {
+    uint32_t offset;            // First pixel of the run
+    uint16_t count;
+    uint16_t type;              // dotstar_clip_run_type
+} dotstar_clip_run;
+
+/*
+@brief An open clip. The caller provides the storage, so playing a clip does
+       not allocate. Treat the fields as private.
+*/
+typedef struct {
+    const uint8_t * data;
+    size_t size;
+    const dotstar_clip_header * header;
+    const uint32_t * index;
+    uint32_t next_frame;        // The frame that follows the one last decoded
+} dotstar_clip;
+
+/*
+@brief Map a clip file and check it. Every frame and run is checked against
+       the file size here so decoding does not have to.
+
+@param clip  Receives the open clip
+@param path  The clip file
+@return 0 on success, nonzero if the file can't be read or is not a valid clip
+*/
+int dotstar_clip_open(dotstar_clip * clip, const char * path);
+
+/*
+@brief Unmap a clip.
+*/
+void dotstar_clip_close(dotstar_clip * clip);
+
+uint32_t dotstar_clip_num_frames(const dotstar_clip * clip);
+uint32_t dotstar_clip_fps(const dotstar_clip * clip);
+
+/*
+@brief Decode a frame into the strip buffer. Playing forward decodes only
+       the deltas since the last frame. Any other frame is decoded from the
+       key frame before it. The strip buffer must not be changed by anything
+       else between frames, or call dotstar_clip_rewind() after it is.
+
+@param clip  The clip
+@param strip  The strip to draw on
+@param frame  The frame number, starting at 0
+@return 0 on success, nonzero if frame is past the end of the clip or the
+        clip was made for a different number of LEDs than the strip has
+*/
+int dotstar_clip_decode(dotstar_clip * clip, dotstar_t * strip, uint32_t frame);
+
+/*
+@brief Make the next dotstar_clip_decode() start from a key frame.
+*/
+void dotstar_clip_rewind(dotstar_clip * clip);
+
+/*
+@brief Render function for dotstar_anim_run() with a dotstar_clip as its
+       argument. Ends the animation after the last frame.
+*/
+int dotstar_clip_render(dotstar_t * strip, uint32_t frame, void * arg);
+
+#endif
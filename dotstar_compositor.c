@@ -0,0 +1,302 @@
+/*!
+ *	@file		dotstar_compositor.c
+ *	@author		BCA
+ *	@version	1.0.0
+ *	@date		12/2/16
+ *	@brief		Source for Dotstar layer compositor
+ *	@copyright	 Bay Computer Associates, Incorporated 2016
+				All rights reserved
+				This file contains CONFIDENTIAL material
+ *	@remark		Matilda USPS Blue Box
+ *	@Repository URL: $HeadURL: $
+ *	Last changed by: $Author: $
+ *	Last changed on: $Date: $
+ *	Revision:		$Rev: $
+**/
+
+#include "dotstar_compositor.h"
+#include "dotstar_kernels.h"
+#include <stdlib.h>
+#include <string.h> // for memcpy, strncpy
+
+typedef struct {
+    char name[DOTSTAR_LAYER_NAME_MAX];
+    uint32_t offset;
+    uint32_t count;
+    dotstar_blend_mode mode;
+    uint8_t alpha;
+    int visible;
+    int dirty;
+    uint32_t * pixels;
+} dotstar_layer;
+
+typedef struct {
+    uint32_t start;
+    uint32_t end;
+} dotstar_range;
+
+struct dotstar_compositor {
+    dotstar_t * strip;
+    uint32_t numLEDs;
+    uint32_t num_layers;
+    uint32_t max_layers;
+    dotstar_layer * layers;
+    dotstar_range * ranges;     // Dirty zones, one per layer at most
+    uint32_t * frame;           // Last flattened frame
+    uint32_t * scratch;         // Blend temporary, same size as frame
+    uint32_t black;
+};
+
+static dotstar_layer * dotstar_comp_layer(dotstar_compositor_t * comp, int layer)
+{
+    if (comp == NULL || layer < 0 || (uint32_t)layer >= comp->num_layers) {
+        return NULL;
+    }
+    return &comp->layers[layer];
+}
+
+dotstar_compositor_t * dotstar_comp_create(dotstar_t * strip, uint32_t max_layers)
+{
+    dotstar_compositor_t *comp = (dotstar_compositor_t *) calloc(1, sizeof(dotstar_compositor_t));
+    if (comp == NULL) {
+        return NULL;
+    }
+
+    comp->strip = strip;
+    comp->numLEDs = dotstar_h_num_leds(strip);
+    comp->max_layers = max_layers;
+    comp->black = dotstar_kernel_pixel(0, 0, 0, 0);
+    comp->layers = (dotstar_layer *) calloc(max_layers, sizeof(dotstar_layer));
+    comp->ranges = (dotstar_range *) calloc(max_layers, sizeof(dotstar_range));
+    comp->frame = (uint32_t *) malloc(comp->numLEDs * 4);
+    comp->scratch = (uint32_t *) malloc(comp->numLEDs * 4);
+
+    if (comp->layers == NULL || comp->ranges == NULL ||
+        comp->frame == NULL || comp->scratch == NULL) {
+        dotstar_comp_destroy(comp);
+        return NULL;
+    }
+    return comp;
+}
+
+void dotstar_comp_destroy(dotstar_compositor_t * comp)
+{
+    if (comp == NULL) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < comp->num_layers; i++) {
+        free(comp->layers[i].pixels);
+    }
+    free(comp->layers);
+    free(comp->ranges);
+    free(comp->frame);
+    free(comp->scratch);
+    free(comp);
+}
+
+int dotstar_comp_add_layer(dotstar_compositor_t * comp,
+                           const char * name,
+                           uint32_t offset,
+                           uint32_t count,
+                           dotstar_blend_mode mode,
+                           uint8_t alpha)
+{
+    if (comp == NULL || comp->num_layers >= comp->max_layers || offset >= comp->numLEDs) {
+        return -1;
+    }
+    if (count > comp->numLEDs - offset) {
+        count = comp->numLEDs - offset;
+    }
+
+    dotstar_layer *layer = &comp->layers[comp->num_layers];
+    layer->pixels = (uint32_t *) malloc(count * 4);
+    if (layer->pixels == NULL) {
+        return -1;
+    }
+    dotstar_kernels->fill(layer->pixels, count, comp->black);
+
+    strncpy(layer->name, name, DOTSTAR_LAYER_NAME_MAX - 1);
+    layer->name[DOTSTAR_LAYER_NAME_MAX - 1] = '\0';
+    layer->offset = offset;
+    layer->count = count;
+    layer->mode = mode;
+    layer->alpha = alpha;
+    layer->visible = 1;
+    layer->dirty = 1;
+
+    return comp->num_layers++;
+}
+
+int dotstar_comp_find_layer(const dotstar_compositor_t * comp, const char * name)
+{
+    if (comp == NULL) {
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < comp->num_layers; i++) {
+        if (strncmp(comp->layers[i].name, name, DOTSTAR_LAYER_NAME_MAX - 1) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+uint32_t * dotstar_comp_layer_pixels(dotstar_compositor_t * comp, int layer, uint32_t * count)
+{
+    dotstar_layer *l = dotstar_comp_layer(comp, layer);
+    if (l == NULL) {
+        if (count != NULL) {
+            *count = 0;
+        }
+        return NULL;
+    }
+
+    l->dirty = 1;
+    if (count != NULL) {
+        *count = l->count;
+    }
+    return l->pixels;
+}
+
+void dotstar_comp_layer_fill(dotstar_compositor_t * comp, int layer,
+                             uint8_t r, uint8_t g, uint8_t b, uint8_t brightness)
+{
+    dotstar_layer *l = dotstar_comp_layer(comp, layer);
+    if (l != NULL) {
+        dotstar_kernels->fill(l->pixels, l->count, dotstar_kernel_pixel(r, g, b, brightness));
+        l->dirty = 1;
+    }
+}
+
+void dotstar_comp_set_alpha(dotstar_compositor_t * comp, int layer, uint8_t alpha)
+{
+    dotstar_layer *l = dotstar_comp_layer(comp, layer);
+    if (l != NULL && l->alpha != alpha) {
+        l->alpha = alpha;
+        l->dirty = 1;
+    }
+}
+
+void dotstar_comp_set_mode(dotstar_compositor_t * comp, int layer, dotstar_blend_mode mode)
+{
+    dotstar_layer *l = dotstar_comp_layer(comp, layer);
+    if (l != NULL && l->mode != mode) {
+        l->mode = mode;
+        l->dirty = 1;
+    }
+}
+
+void dotstar_comp_set_visible(dotstar_compositor_t * comp, int layer, int visible)
+{
+    dotstar_layer *l = dotstar_comp_layer(comp, layer);
+    if (l != NULL && l->visible != (visible != 0)) {
+        l->visible = (visible != 0);
+        l->dirty = 1;
+    }
+}
+
+void dotstar_comp_mark_dirty(dotstar_compositor_t * comp, int layer)
+{
+    dotstar_layer *l = dotstar_comp_layer(comp, layer);
+    if (l != NULL) {
+        l->dirty = 1;
+    }
+}
+
+// Blend every layer that overlaps pixels start to end - 1 into the frame,
+// bottom layer first.
+static void dotstar_comp_blend(dotstar_compositor_t * comp, uint32_t start, uint32_t end)
+{
+    dotstar_kernels->fill(&comp->frame[start], end - start, comp->black);
+
+    for (uint32_t i = 0; i < comp->num_layers; i++) {
+        const dotstar_layer *l = &comp->layers[i];
+        uint32_t s = (l->offset > start) ? l->offset : start;
+        uint32_t e = (l->offset + l->count < end) ? l->offset + l->count : end;
+
+        if (!l->visible || l->alpha == 0 || s >= e) {
+            continue;
+        }
+
+        uint32_t n = e - s;
+        uint32_t *dst = &comp->frame[s];
+        uint32_t *tmp = &comp->scratch[s];
+        const uint32_t *src = &l->pixels[s - l->offset];
+        // lerp weight, 0 to 256
+        uint16_t t = l->alpha + (l->alpha >> 7);
+
+        switch (l->mode) {
+        case DOTSTAR_BLEND_NORMAL:
+            if (l->alpha == 255) {
+                memcpy(dst, src, n * 4);
+            } else {
+                dotstar_kernels->lerp(dst, dst, src, n, t);
+            }
+            break;
+        case DOTSTAR_BLEND_ADD:
+            if (l->alpha != 255) {
+                dotstar_kernels->scale(tmp, src, n, l->alpha, l->alpha, l->alpha);
+                src = tmp;
+            }
+            dotstar_kernels->add(dst, src, n);
+            break;
+        case DOTSTAR_BLEND_MULTIPLY:
+            if (l->alpha == 255) {
+                dotstar_kernels->multiply(dst, src, n);
+            } else {
+                memcpy(tmp, dst, n * 4);
+                dotstar_kernels->multiply(tmp, src, n);
+                dotstar_kernels->lerp(dst, dst, tmp, n, t);
+            }
+            break;
+        }
+    }
+}
+
+uint32_t dotstar_comp_flatten(dotstar_compositor_t * comp)
+{
+    uint32_t num_ranges = 0;
+    uint32_t blended = 0;
+
+    if (comp == NULL) {
+        return 0;
+    }
+
+    // Collect the zones of dirty layers, sorted by start.
+    for (uint32_t i = 0; i < comp->num_layers; i++) {
+        dotstar_layer *l = &comp->layers[i];
+        if (!l->dirty) {
+            continue;
+        }
+        l->dirty = 0;
+        if (l->count == 0) {
+            continue;
+        }
+
+        uint32_t j = num_ranges++;
+        while (j > 0 && comp->ranges[j - 1].start > l->offset) {
+            comp->ranges[j] = comp->ranges[j - 1];
+            j--;
+        }
+        comp->ranges[j].start = l->offset;
+        comp->ranges[j].end = l->offset + l->count;
+    }
+
+    // Blend each run of overlapping or touching zones once.
+    for (uint32_t i = 0; i < num_ranges;) {
+        uint32_t start = comp->ranges[i].start;
+        uint32_t end = comp->ranges[i].end;
+
+        for (i++; i < num_ranges && comp->ranges[i].start <= end; i++) {
+            if (comp->ranges[i].end > end) {
+                end = comp->ranges[i].end;
+            }
+        }
+
+        dotstar_comp_blend(comp, start, end);
+        dotstar_h_set_pixels_packed(comp->strip, start, end - start, &comp->frame[start]);
+        blended += end - start;
+    }
+    return blended;
+}
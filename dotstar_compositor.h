@@ -0,0 +1,125 @@
+/*!
+ *	@file		dotstar_compositor.h
+ *	@author		BCA
+ *	@version	1.0.0
+ *	@date		12/2/16
+ *	@brief		Header for Dotstar layer compositor
+ *	@copyright	 Bay Computer Associates, Incorporated 2016
+				All rights reserved
+				This file contains CONFIDENTIAL material
+ *	@remark		Matilda USPS Blue Box
+ *	@Repository URL: $HeadURL: $
+ *	Last changed by: $Author: $
+ *	Last changed on: $Date: $
+ *	Revision:		$Rev: $
+**/
+#ifndef DOTSTAR_COMPOSITOR_H
+#define DOTSTAR_COMPOSITOR_H
+
+#include "dotstar.h"
+
+#include <stdint.h>
+
+/*
+A compositor splits a strip into layers. Each layer covers a range of pixels
+(a zone), has its own pixel buffer in the strip wire format and is blended
+onto the layers added before it. dotstar_comp_flatten() writes the result to
+the strip buffer. Only the pixels under layers that changed since the last
+flatten are blended again, and the rest of the strip is left alone.
+*/
+
+typedef enum {
+    DOTSTAR_BLEND_NORMAL,       // Layer covers the layers below, mixed by alpha
+    DOTSTAR_BLEND_ADD,          // Layer is added to the layers below
+    DOTSTAR_BLEND_MULTIPLY      // Layer darkens the layers below
+} dotstar_blend_mode;
+
+#define DOTSTAR_LAYER_NAME_MAX 16
+
+typedef struct dotstar_compositor dotstar_compositor_t;
+
+/*
+@brief Create a compositor for a strip. Nothing is written to the strip until
+       the first dotstar_comp_flatten().
+
+@param strip  The strip to draw on
+@param max_layers  The most layers that can be added
+@return the compositor, or NULL if it could not be allocated
+*/
+dotstar_compositor_t * dotstar_comp_create(dotstar_t * strip, uint32_t max_layers);
+
+/*
+@brief Free a compositor. The strip is not changed.
+*/
+void dotstar_comp_destroy(dotstar_compositor_t * comp);
+
+/*
+@brief Add a layer on top of the existing ones. The layer starts out black
+       with brightness 0 and dirty.
+
+@param comp  The compositor
+@param name  The zone name, used by dotstar_comp_find_layer(). Truncated to
+             DOTSTAR_LAYER_NAME_MAX - 1 characters.
+@param offset  The first strip pixel the layer covers
+@param count  The number of pixels the layer covers. Clipped to the strip.
+@param mode  How the layer is blended onto the ones below it
+@param alpha  Layer opacity. 255 is opaque and 0 is invisible.
+@return the layer number, or -1 if the layer can't be added
+*/
+int dotstar_comp_add_layer(dotstar_compositor_t * comp,
+                           const char * name,
+                           uint32_t offset,
+                           uint32_t count,
+                           dotstar_blend_mode mode,
+                           uint8_t alpha);
+
+/*
+@brief Look up a layer by name.
+
+@return the layer number, or -1 if there is no layer by that name
+*/
+int dotstar_comp_find_layer(const dotstar_compositor_t * comp, const char * name);
+
+/*
+@brief Get a layer's pixel buffer to draw into. Pixels are in the strip wire
+       format and index 0 is the first pixel of the layer's zone. The layer
+       is marked dirty.
+
+@param comp  The compositor
+@param layer  The layer number
+@param count  Receives the number of pixels in the buffer. May be NULL.
+@return the pixel buffer, or NULL if there is no such layer
+*/
+uint32_t * dotstar_comp_layer_pixels(dotstar_compositor_t * comp, int layer, uint32_t * count);
+
+/*
+@brief Set every pixel of a layer to the same color. Max brightness is 15.
+*/
+void dotstar_comp_layer_fill(dotstar_compositor_t * comp, int layer,
+                             uint8_t r, uint8_t g, uint8_t b, uint8_t brightness);
+
+/*
+@brief Change how a layer is blended. Setting a value that differs from the
+       current one marks the layer dirty.
+*/
+void dotstar_comp_set_alpha(dotstar_compositor_t * comp, int layer, uint8_t alpha);
+void dotstar_comp_set_mode(dotstar_compositor_t * comp, int layer, dotstar_blend_mode mode);
+void dotstar_comp_set_visible(dotstar_compositor_t * comp, int layer, int visible);
+
+/*
+@brief Mark a layer dirty after drawing into a buffer obtained earlier from
+       dotstar_comp_layer_pixels().
+*/
+void dotstar_comp_mark_dirty(dotstar_compositor_t * comp, int layer);
+
+/*
+@brief Blend the zones of all dirty layers and write them to the strip
+       buffer. Call dotstar_h_show() afterwards to send the frame. When no
+       layer is dirty the strip buffer is not touched, so the show is
+       skipped as an unchanged frame.
+
+@return the number of pixels blended
+*/
+uint32_t dotstar_comp_flatten(dotstar_compositor_t * comp);
+
+#endif
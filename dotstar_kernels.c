@@ -0,0 +1,386 @@
+/*!
+ *	@file		dotstar_kernels.c
+ *	@author		BCA
+ *	@version	1.0.0
+ *	@date		12/2/16
+ *	@brief		Source for Dotstar pixel kernels
+ *	@copyright	 Bay Computer Associates, Incorporated 2016
+				All rights reserved
+				This file contains CONFIDENTIAL material
+ *	@remark		Matilda USPS Blue Box
+ *	@Repository URL: $HeadURL: $
+ *	Last changed by: $Author: $
+ *	Last changed on: $Date: $
+ *	Revision:		$Rev: $
+**/
+
+#include "dotstar_kernels.h"
+#include "dotstar.h"
+#include "dotstar_chipset.h"
+#include <string.h> // for memcpy
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+uint32_t dotstar_kernel_pixel(uint8_t r, uint8_t g, uint8_t b, uint8_t brightness)
+{
+    uint32_t pixel;
+    uint8_t *ptr = (uint8_t*)&pixel;
+
+    if (brightness > PIXEL_MAX_BRIGHTNESS) {
+        brightness = PIXEL_MAX_BRIGHTNESS;
+    }
+    ptr[0] = brightness | DOTSTAR_START_BITS;
+    ptr[DOTSTAR_RED_BYTE] = r;
+    ptr[DOTSTAR_GREEN_BYTE] = g;
+    ptr[DOTSTAR_BLUE_BYTE] = b;
+    return pixel;
+}
+
+// Gradient step per pixel in 16.16 fixed point, where 256.0 is the end of
+// the gradient. It is rounded up and the position clamped to 256 so the last
+// pixel lands exactly on the end color. Both kernel sets step by the same
+// amount so their results match exactly.
+static uint32_t gradient_step(uint32_t steps)
+{
+    return (steps > 1) ? ((256u << 16) + steps - 2) / (steps - 1) : 0;
+}
+
+//======================================================================
+// Scalar kernels.
+
+static void fill_scalar(uint32_t * dst, uint32_t count, uint32_t pixel)
+{
+    for (uint32_t i = 0; i < count; i++) {
+        dst[i] = pixel;
+    }
+}
+
+static void gradient_scalar(uint32_t * dst, uint32_t count, uint32_t from, uint32_t to,
+                            uint32_t start, uint32_t steps)
+{
+    const uint8_t *a = (const uint8_t*)&from;
+    const uint8_t *b = (const uint8_t*)&to;
+    uint32_t step = gradient_step(steps);
+    uint32_t pos = start * step;
+
+    for (uint8_t * ptr = (uint8_t*)dst, * end = ptr + count * 4; ptr < end; ptr += 4, pos += step) {
+        uint32_t t = pos >> 16;
+        if (t > 256) {
+            t = 256;
+        }
+        for (int c = 0; c < 4; c++) {
+            ptr[c] = (uint8_t)((a[c] * (256 - t) + b[c] * t) >> 8);
+        }
+    }
+}
+
+static void scale_scalar(uint32_t * dst, const uint32_t * src, uint32_t count,
+                         uint8_t r, uint8_t g, uint8_t b)
+{
+    const uint8_t * in = (const uint8_t*)src;
+    uint8_t * out = (uint8_t*)dst;
+
+    for (uint32_t i = 0; i < count; i++, in += 4, out += 4) {
+        out[0] = in[0];
+        out[DOTSTAR_RED_BYTE] = (uint8_t)((in[DOTSTAR_RED_BYTE] * (r + 1)) >> 8);
+        out[DOTSTAR_GREEN_BYTE] = (uint8_t)((in[DOTSTAR_GREEN_BYTE] * (g + 1)) >> 8);
+        out[DOTSTAR_BLUE_BYTE] = (uint8_t)((in[DOTSTAR_BLUE_BYTE] * (b + 1)) >> 8);
+    }
+}
+
+static void lerp_scalar(uint32_t * dst, const uint32_t * a, const uint32_t * b,
+                        uint32_t count, uint16_t t)
+{
+    const uint8_t * in_a = (const uint8_t*)a;
+    const uint8_t * in_b = (const uint8_t*)b;
+    uint8_t * out = (uint8_t*)dst;
+
+    for (uint32_t i = 0; i < count * 4; i++) {
+        out[i] = (uint8_t)((in_a[i] * (256 - t) + in_b[i] * t) >> 8);
+    }
+}
+
+static void add_scalar(uint32_t * dst, const uint32_t * src, uint32_t count)
+{
+    const uint8_t * in = (const uint8_t*)src;
+    uint8_t * out = (uint8_t*)dst;
+
+    for (uint32_t i = 0; i < count; i++, in += 4, out += 4) {
+        if (in[0] > out[0]) {
+            out[0] = in[0];
+        }
+        for (int c = 1; c < 4; c++) {
+            uint32_t sum = out[c] + in[c];
+            out[c] = (sum > 255) ? 255 : (uint8_t)sum;
+        }
+    }
+}
+
+static void multiply_scalar(uint32_t * dst, const uint32_t * src, uint32_t count)
+{
+    const uint8_t * in = (const uint8_t*)src;
+    uint8_t * out = (uint8_t*)dst;
+
+    for (uint32_t i = 0; i < count; i++, in += 4, out += 4) {
+        if (in[0] < out[0]) {
+            out[0] = in[0];
+        }
+        for (int c = 1; c < 4; c++) {
+            out[c] = (uint8_t)((out[c] * (in[c] + 1)) >> 8);
+        }
+    }
+}
+
+static void select_scalar(uint32_t * dst, const uint32_t * a, const uint32_t * b,
+                          const uint8_t * key, uint32_t count, uint16_t level)
+{
+    for (uint32_t i = 0; i < count; i++) {
+        dst[i] = (key[i] < level) ? b[i] : a[i];
+    }
+}
+
+static void pack_scalar(uint32_t * dst, const dotstar_planes * src, uint32_t count)
+{
+    uint8_t * out = (uint8_t*)dst;
+
+    for (uint32_t i = 0; i < count; i++, out += 4) {
+        uint8_t brightness = src->brightness[i];
+        if (brightness > PIXEL_MAX_BRIGHTNESS) {
+            brightness = PIXEL_MAX_BRIGHTNESS;
+        }
+        out[0] = brightness | DOTSTAR_START_BITS;
+        out[DOTSTAR_RED_BYTE] = src->r[i];
+        out[DOTSTAR_GREEN_BYTE] = src->g[i];
+        out[DOTSTAR_BLUE_BYTE] = src->b[i];
+    }
+}
+
+static void unpack_scalar(const dotstar_planes * dst, const uint32_t * src, uint32_t count)
+{
+    const uint8_t * in = (const uint8_t*)src;
+
+    for (uint32_t i = 0; i < count; i++, in += 4) {
+        dst->brightness[i] = in[0] & 0x0F;
+        dst->r[i] = in[DOTSTAR_RED_BYTE];
+        dst->g[i] = in[DOTSTAR_GREEN_BYTE];
+        dst->b[i] = in[DOTSTAR_BLUE_BYTE];
+    }
+}
+
+const dotstar_kernel_set dotstar_kernels_scalar = {
+    .name     = "scalar",
+    .fill     = fill_scalar,
+    .gradient = gradient_scalar,
+    .scale    = scale_scalar,
+    .lerp     = lerp_scalar,
+    .add      = add_scalar,
+    .multiply = multiply_scalar,
+    .select   = select_scalar,
+    .pack     = pack_scalar,
+    .unpack   = unpack_scalar
+};
+
+//======================================================================
+// NEON kernels. Each handles 4 pixels (16 bytes) per step unless noted and
+// finishes any remainder with the scalar kernel.
+
+#if defined(__ARM_NEON)
+
+static void fill_neon(uint32_t * dst, uint32_t count, uint32_t pixel)
+{
+    const uint32x4_t value = vdupq_n_u32(pixel);
+    uint32_t i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        vst1q_u32(&dst[i], value);
+    }
+    fill_scalar(&dst[i], count - i, pixel);
+}
+
+static void gradient_neon(uint32_t * dst, uint32_t count, uint32_t from, uint32_t to,
+                          uint32_t start, uint32_t steps)
+{
+    const uint32_t step = gradient_step(steps);
+    const uint16x8_t a = vmovl_u8(vreinterpret_u8_u32(vdup_n_u32(from)));
+    const uint16x8_t b = vmovl_u8(vreinterpret_u8_u32(vdup_n_u32(to)));
+    const uint16x8_t a256 = vshlq_n_u16(a, 8);
+    const uint32x4_t inc = vdupq_n_u32(step * 4);
+    const uint16x4_t end = vdup_n_u16(256);
+    const uint32_t first[4] = { 0, step, step * 2, step * 3 };
+    uint32x4_t pos = vaddq_u32(vdupq_n_u32(start * step), vld1q_u32(first));
+    uint32_t i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        // Spread each pixel's weight over its 4 bytes.
+        uint16x4_t t = vmin_u16(vshrn_n_u32(pos, 16), end);
+        uint16x4x2_t t2 = vzip_u16(t, t);
+        uint16x4x2_t t01 = vzip_u16(t2.val[0], t2.val[0]);
+        uint16x4x2_t t23 = vzip_u16(t2.val[1], t2.val[1]);
+        uint16x8_t w01 = vcombine_u16(t01.val[0], t01.val[1]);
+        uint16x8_t w23 = vcombine_u16(t23.val[0], t23.val[1]);
+
+        // a * (256 - t) + b * t. Intermediate values may wrap, but the
+        // result fits in 16 bits so it is exact.
+        uint16x8_t r01 = vmlaq_u16(vmlsq_u16(a256, a, w01), b, w01);
+        uint16x8_t r23 = vmlaq_u16(vmlsq_u16(a256, a, w23), b, w23);
+        vst1q_u8((uint8_t*)&dst[i], vcombine_u8(vshrn_n_u16(r01, 8), vshrn_n_u16(r23, 8)));
+
+        pos = vaddq_u32(pos, inc);
+    }
+    gradient_scalar(&dst[i], count - i, from, to, start + i, steps);
+}
+
+static void scale_neon(uint32_t * dst, const uint32_t * src, uint32_t count,
+                       uint8_t r, uint8_t g, uint8_t b)
+{
+    // 255 in the brightness lane leaves it unchanged.
+    const uint8x16_t factor = vreinterpretq_u8_u32(vdupq_n_u32(
+        0xFFu | ((uint32_t)r << (DOTSTAR_RED_BYTE * 8)) |
+        ((uint32_t)g << (DOTSTAR_GREEN_BYTE * 8)) | ((uint32_t)b << (DOTSTAR_BLUE_BYTE * 8))));
+    uint32_t i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        uint8x16_t in = vld1q_u8((const uint8_t*)&src[i]);
+        uint16x8_t lo = vaddw_u8(vmull_u8(vget_low_u8(in), vget_low_u8(factor)), vget_low_u8(in));
+        uint16x8_t hi = vaddw_u8(vmull_u8(vget_high_u8(in), vget_high_u8(factor)), vget_high_u8(in));
+        vst1q_u8((uint8_t*)&dst[i], vcombine_u8(vshrn_n_u16(lo, 8), vshrn_n_u16(hi, 8)));
+    }
+    scale_scalar(&dst[i], &src[i], count - i, r, g, b);
+}
+
+static void lerp_neon(uint32_t * dst, const uint32_t * a, const uint32_t * b,
+                      uint32_t count, uint16_t t)
+{
+    const uint16x8_t w = vdupq_n_u16(t);
+    uint32_t i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        uint8x16_t in_a = vld1q_u8((const uint8_t*)&a[i]);
+        uint8x16_t in_b = vld1q_u8((const uint8_t*)&b[i]);
+        uint16x8_t a_lo = vmovl_u8(vget_low_u8(in_a));
+        uint16x8_t a_hi = vmovl_u8(vget_high_u8(in_a));
+        uint16x8_t lo = vmlaq_u16(vmlsq_u16(vshlq_n_u16(a_lo, 8), a_lo, w),
+                                  vmovl_u8(vget_low_u8(in_b)), w);
+        uint16x8_t hi = vmlaq_u16(vmlsq_u16(vshlq_n_u16(a_hi, 8), a_hi, w),
+                                  vmovl_u8(vget_high_u8(in_b)), w);
+        vst1q_u8((uint8_t*)&dst[i], vcombine_u8(vshrn_n_u16(lo, 8), vshrn_n_u16(hi, 8)));
+    }
+    lerp_scalar(&dst[i], &a[i], &b[i], count - i, t);
+}
+
+static void add_neon(uint32_t * dst, const uint32_t * src, uint32_t count)
+{
+    const uint8x16_t brightness = vreinterpretq_u8_u32(vdupq_n_u32(0xFF));
+    uint32_t i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        uint8x16_t d = vld1q_u8((const uint8_t*)&dst[i]);
+        uint8x16_t s = vld1q_u8((const uint8_t*)&src[i]);
+        vst1q_u8((uint8_t*)&dst[i], vbslq_u8(brightness, vmaxq_u8(d, s), vqaddq_u8(d, s)));
+    }
+    add_scalar(&dst[i], &src[i], count - i);
+}
+
+static void multiply_neon(uint32_t * dst, const uint32_t * src, uint32_t count)
+{
+    const uint8x16_t brightness = vreinterpretq_u8_u32(vdupq_n_u32(0xFF));
+    uint32_t i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        uint8x16_t d = vld1q_u8((const uint8_t*)&dst[i]);
+        uint8x16_t s = vld1q_u8((const uint8_t*)&src[i]);
+        uint16x8_t lo = vaddw_u8(vmull_u8(vget_low_u8(d), vget_low_u8(s)), vget_low_u8(d));
+        uint16x8_t hi = vaddw_u8(vmull_u8(vget_high_u8(d), vget_high_u8(s)), vget_high_u8(d));
+        uint8x16_t product = vcombine_u8(vshrn_n_u16(lo, 8), vshrn_n_u16(hi, 8));
+        vst1q_u8((uint8_t*)&dst[i], vbslq_u8(brightness, vminq_u8(d, s), product));
+    }
+    multiply_scalar(&dst[i], &src[i], count - i);
+}
+
+// Handles 16 pixels per step, one key vector at a time.
+static void select_neon(uint32_t * dst, const uint32_t * a, const uint32_t * b,
+                        const uint8_t * key, uint32_t count, uint16_t level)
+{
+    uint32_t i = 0;
+
+    if (level > 255) {
+        memcpy(dst, b, count * 4);
+        return;
+    }
+
+    const uint8x16_t limit = vdupq_n_u8(level);
+    for (; i + 16 <= count; i += 16) {
+        // Widen each key byte's result to cover the pixel's 4 bytes.
+        uint8x16_t pick = vcltq_u8(vld1q_u8(&key[i]), limit);
+        uint8x16x2_t p2 = vzipq_u8(pick, pick);
+        uint8x16x2_t p01 = vzipq_u8(p2.val[0], p2.val[0]);
+        uint8x16x2_t p23 = vzipq_u8(p2.val[1], p2.val[1]);
+        uint8x16_t mask[4] = { p01.val[0], p01.val[1], p23.val[0], p23.val[1] };
+
+        for (int j = 0; j < 4; j++) {
+            uint8x16_t in_a = vld1q_u8((const uint8_t*)&a[i + j * 4]);
+            uint8x16_t in_b = vld1q_u8((const uint8_t*)&b[i + j * 4]);
+            vst1q_u8((uint8_t*)&dst[i + j * 4], vbslq_u8(mask[j], in_b, in_a));
+        }
+    }
+    select_scalar(&dst[i], &a[i], &b[i], &key[i], count - i, level);
+}
+
+// The planar kernels handle 16 pixels per step.
+static void pack_neon(uint32_t * dst, const dotstar_planes * src, uint32_t count)
+{
+    const uint8x16_t max = vdupq_n_u8(PIXEL_MAX_BRIGHTNESS);
+    const uint8x16_t start = vdupq_n_u8(DOTSTAR_START_BITS);
+    uint32_t i = 0;
+
+    for (; i + 16 <= count; i += 16) {
+        uint8x16x4_t out;
+        out.val[0] = vorrq_u8(vminq_u8(vld1q_u8(&src->brightness[i]), max), start);
+        out.val[DOTSTAR_RED_BYTE] = vld1q_u8(&src->r[i]);
+        out.val[DOTSTAR_GREEN_BYTE] = vld1q_u8(&src->g[i]);
+        out.val[DOTSTAR_BLUE_BYTE] = vld1q_u8(&src->b[i]);
+        vst4q_u8((uint8_t*)&dst[i], out);
+    }
+
+    dotstar_planes rest = { &src->r[i], &src->g[i], &src->b[i], &src->brightness[i] };
+    pack_scalar(&dst[i], &rest, count - i);
+}
+
+static void unpack_neon(const dotstar_planes * dst, const uint32_t * src, uint32_t count)
+{
+    const uint8x16_t mask = vdupq_n_u8(0x0F);
+    uint32_t i = 0;
+
+    for (; i + 16 <= count; i += 16) {
+        uint8x16x4_t in = vld4q_u8((const uint8_t*)&src[i]);
+        vst1q_u8(&dst->brightness[i], vandq_u8(in.val[0], mask));
+        vst1q_u8(&dst->r[i], in.val[DOTSTAR_RED_BYTE]);
+        vst1q_u8(&dst->g[i], in.val[DOTSTAR_GREEN_BYTE]);
+        vst1q_u8(&dst->b[i], in.val[DOTSTAR_BLUE_BYTE]);
+    }
+
+    dotstar_planes rest = { &dst->r[i], &dst->g[i], &dst->b[i], &dst->brightness[i] };
+    unpack_scalar(&rest, &src[i], count - i);
+}
+
+const dotstar_kernel_set dotstar_kernels_neon = {
+    .name     = "neon",
+    .fill     = fill_neon,
+    .gradient = gradient_neon,
+    .scale    = scale_neon,
+    .lerp     = lerp_neon,
+    .add      = add_neon,
+    .multiply = multiply_neon,
+    .select   = select_neon,
+    .pack     = pack_neon,
+    .unpack   = unpack_neon
+};
+
+const dotstar_kernel_set * const dotstar_kernels = &dotstar_kernels_neon;
+
+#else
+
+const dotstar_kernel_set * const dotstar_kernels = &dotstar_kernels_scalar;
+
+#endif
@@ -0,0 +1,116 @@
+/*!
+ *	@file		dotstar_kernels.h
+ *	@author		BCA
+ *	@version	1.0.0
+ *	@date		12/2/16
+ *	@brief		Header for Dotstar pixel kernels
+ *	@copyright	 Bay Computer Associates, Incorporated 2016
+				All rights reserved
+				This file contains CONFIDENTIAL material
+ *	@remark		Matilda USPS Blue Box
+ *	@Repository URL: $HeadURL: $
+ *	Last changed by: $Author: $
+ *	Last changed on: $Date: $
+ *	Revision:		$Rev: $
+**/
+#ifndef DOTSTAR_KERNELS_H
+#define DOTSTAR_KERNELS_H
+
+#include "dotstar.h"
+
+#include <stdint.h>
+
+/*
+Kernels operate on pixels in the strip wire format. Each pixel is one
+uint32_t holding 4 bytes in memory order: the start bits ORed with the 5-bit
+brightness, then the three colors in the order of the build's chipset (see
+DOTSTAR_CHIPSET_LIST in dotstar_chipset.h). Use dotstar_kernel_pixel() to
+build one.
+
+Every kernel has a portable scalar version and, on builds with NEON, a
+vectorized version that produces identical results. dotstar_kernels points
+to the fastest set for the build.
+*/
+typedef struct {
+    const char * name;
+
+    /*
+    @brief Set every pixel to the same value.
+    */
+    void (*fill)(uint32_t * dst, uint32_t count, uint32_t pixel);
+
+    /*
+    @brief Linear gradient from one pixel value to another. The gradient spans
+           steps pixels. dst receives pixels start to start + count - 1 of
+           it, so a gradient can be written in pieces.
+    */
+    void (*gradient)(uint32_t * dst, uint32_t count, uint32_t from, uint32_t to,
+                     uint32_t start, uint32_t steps);
+
+    /*
+    @brief Scale each color channel. A factor of 255 leaves the channel
+           unchanged and 0 turns it off. Brightness is not changed.
+    */
+    void (*scale)(uint32_t * dst, const uint32_t * src, uint32_t count,
+                  uint8_t r, uint8_t g, uint8_t b);
+
+    /*
+    @brief Interpolate between two frames. t is 0 to 256, where 0 gives a and
+           256 gives b. Brightness is interpolated too.
+    */
+    void (*lerp)(uint32_t * dst, const uint32_t * a, const uint32_t * b,
+                 uint32_t count, uint16_t t);
+
+    /*
+    @brief Add src to dst. Color channels saturate at 255 and the brighter
+           of the two global brightness values is kept.
+    */
+    void (*add)(uint32_t * dst, const uint32_t * src, uint32_t count);
+
+    /*
+    @brief Multiply dst by src. A src channel of 255 leaves the dst channel
+           unchanged and 0 turns it off. The dimmer of the two global
+           brightness values is kept.
+    */
+    void (*multiply)(uint32_t * dst, const uint32_t * src, uint32_t count);
+
+    /*
+    @brief Pick each pixel from b where key is below level and from a
+           elsewhere. A level of 256 picks every pixel from b.
+    */
+    void (*select)(uint32_t * dst, const uint32_t * a, const uint32_t * b,
+                   const uint8_t * key, uint32_t count, uint16_t level);
+
+    /*
+    @brief Interleave planar channels into pixels. Brightness is limited to
+           PIXEL_MAX_BRIGHTNESS.
+    */
+    void (*pack)(uint32_t * dst, const dotstar_planes * src, uint32_t count);
+
+    /*
+    @brief Split pixels into planar channels.
+    */
+    void (*unpack)(const dotstar_planes * dst, const uint32_t * src, uint32_t count);
+} dotstar_kernel_set;
+
+extern const dotstar_kernel_set dotstar_kernels_scalar;
+#if defined(__ARM_NEON)
+extern const dotstar_kernel_set dotstar_kernels_neon;
+#endif
+
+// The fastest kernel set for this build.
+extern const dotstar_kernel_set * const dotstar_kernels;
+
+/*
+@brief Build a pixel in the wire format
+
+@param r  red
+@param g  green
+@param b  blue
+@param brightness  The global brightness of the pixel, independent of color.
+                   Max brightness is 15.
+@return the pixel
+*/
+uint32_t dotstar_kernel_pixel(uint8_t r, uint8_t g, uint8_t b, uint8_t brightness);
+
+#endif
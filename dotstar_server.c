@@ -0,0 +1,311 @@
+/*!
+ *	@file		dotstar_server.c
+ *	@author		BCA
+ *	@version	1.0.0
+ *	@date		12/2/16
+ *	@brief		Source for the Dotstar shared-memory frame server
+ *	@copyright	 Bay Computer Associates, Incorporated 2016
+				All rights reserved
+				This file contains CONFIDENTIAL material
+ *	@remark		Matilda USPS Blue Box
+ *	@Repository URL: $HeadURL: $
+ *	Last changed by: $Author: $
+ *	Last changed on: $Date: $
+ *	Revision:		$Rev: $
+**/
+
+#include "dotstar_server.h"
+#include "dotstar_shm.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h> // for strncpy
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// How long the server thread sleeps between checks of its stop flag when no
+// frames arrive.
+#define DOTSTAR_SERVER_IDLE_NS 100000000
+
+// An object with no magic yet is taken to be one another server is still
+// setting up, unless it is older than this.
+#define DOTSTAR_SERVER_SETUP_S 5
+
+// The layout fields are kept here rather than read back from the mapping,
+// which any local process can write.
+struct dotstar_server {
+    dotstar_t * strip;
+    char name[64];
+    dotstar_shm_header * header;
+    size_t size;
+    uint32_t num_leds;
+    uint32_t num_slots;
+    uint32_t slot_offset;
+    uint32_t slot_stride;
+    pthread_t thread;
+    int stop;
+};
+
+static uint32_t dotstar_server_align(uint32_t size)
+{
+    return (size + DOTSTAR_SHM_ALIGN - 1) & ~(uint32_t)(DOTSTAR_SHM_ALIGN - 1);
+}
+
+static dotstar_rgbb * dotstar_server_frame(dotstar_server_t * server, uint32_t slot)
+{
+    return (dotstar_rgbb *)((uint8_t *)server->header + server->slot_offset +
+                            slot * server->slot_stride);
+}
+
+// True if pid names a running process. EPERM means it runs as another user.
+static int dotstar_server_pid_alive(uint32_t pid)
+{
+    return pid != 0 && (kill((pid_t)pid, 0) == 0 || errno == EPERM);
+}
+
+// Free every READY slot published before seq, counting each as dropped.
+static void dotstar_server_drop_older(dotstar_server_t * server, uint32_t seq)
+{
+    dotstar_shm_header *header = server->header;
+    dotstar_shm_slot *slots = dotstar_shm_slots(header);
+
+    for (uint32_t i = 0; i < server->num_slots; i++) {
+        uint32_t expected = DOTSTAR_SHM_READY;
+        if (!__atomic_compare_exchange_n(&slots[i].state, &expected, DOTSTAR_SHM_READING, 0,
+                                         __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            continue;
+        }
+        // Holding the slot, so its seq can't change under us.
+        if ((int32_t)(slots[i].seq - seq) < 0) {
+            __atomic_add_fetch(&header->frames_dropped, 1, __ATOMIC_RELAXED);
+            __atomic_store_n(&slots[i].state, DOTSTAR_SHM_FREE, __ATOMIC_RELEASE);
+        } else {
+            __atomic_store_n(&slots[i].state, DOTSTAR_SHM_READY, __ATOMIC_RELEASE);
+        }
+    }
+}
+
+// Free WRITING slots whose client has exited. A slot whose owner is not
+// stored yet is left alone; the client stores it right after the claim.
+static void dotstar_server_reclaim(dotstar_server_t * server)
+{
+    dotstar_shm_slot *slots = dotstar_shm_slots(server->header);
+
+    for (uint32_t i = 0; i < server->num_slots; i++) {
+        if (__atomic_load_n(&slots[i].state, __ATOMIC_ACQUIRE) != DOTSTAR_SHM_WRITING) {
+            continue;
+        }
+        uint32_t owner = __atomic_load_n(&slots[i].owner, __ATOMIC_RELAXED);
+        if (owner == 0 || dotstar_server_pid_alive(owner)) {
+            continue;
+        }
+        uint32_t expected = DOTSTAR_SHM_WRITING;
+        if (__atomic_load_n(&slots[i].owner, __ATOMIC_RELAXED) == owner &&
+            __atomic_compare_exchange_n(&slots[i].state, &expected, DOTSTAR_SHM_READING, 0,
+                                        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            __atomic_store_n(&slots[i].owner, 0, __ATOMIC_RELAXED);
+            __atomic_store_n(&slots[i].state, DOTSTAR_SHM_FREE, __ATOMIC_RELEASE);
+        }
+    }
+}
+
+static void * dotstar_server_thread(void * arg)
+{
+    dotstar_server_t *server = (dotstar_server_t *) arg;
+    dotstar_shm_header *header = server->header;
+    dotstar_shm_slot *slots = dotstar_shm_slots(header);
+    const struct timespec idle = { 0, DOTSTAR_SERVER_IDLE_NS };
+
+    while (!__atomic_load_n(&server->stop, __ATOMIC_ACQUIRE)) {
+        // Read the doorbell before looking at the slots so a frame published
+        // after the scan ends the wait at once.
+        uint32_t doorbell = __atomic_load_n(&header->doorbell, __ATOMIC_ACQUIRE);
+        int32_t newest = -1;
+        uint32_t newest_seq = 0;
+
+        for (uint32_t i = 0; i < server->num_slots; i++) {
+            if (__atomic_load_n(&slots[i].state, __ATOMIC_ACQUIRE) == DOTSTAR_SHM_READY) {
+                uint32_t seq = __atomic_load_n(&slots[i].seq, __ATOMIC_RELAXED);
+                if (newest < 0 || (int32_t)(seq - newest_seq) > 0) {
+                    newest = i;
+                    newest_seq = seq;
+                }
+            }
+        }
+
+        if (newest < 0) {
+            // Idle passes are also when slots left by dead clients are freed.
+            if (dotstar_shm_wait(&header->doorbell, doorbell, &idle) != 0 && errno == ETIMEDOUT) {
+                dotstar_server_reclaim(server);
+            }
+            continue;
+        }
+
+        uint32_t expected = DOTSTAR_SHM_READY;
+        if (!__atomic_compare_exchange_n(&slots[newest].state, &expected, DOTSTAR_SHM_READING, 0,
+                                         __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            // A client took it back to draw a newer frame.
+            continue;
+        }
+        newest_seq = slots[newest].seq;
+        dotstar_server_drop_older(server, newest_seq);
+
+        dotstar_h_set_pixels(server->strip, 0, server->num_leds, dotstar_server_frame(server, newest));
+        __atomic_store_n(&slots[newest].state, DOTSTAR_SHM_FREE, __ATOMIC_RELEASE);
+        dotstar_h_show(server->strip);
+        __atomic_add_fetch(&header->frames_shown, 1, __ATOMIC_RELAXED);
+    }
+    return NULL;
+}
+
+// Create the object. If one exists, it is only replaced when the server that
+// made it has exited, so a running server keeps its clients.
+static int dotstar_server_create(const char * name)
+{
+    for (int attempt = 0; attempt < 2; attempt++) {
+        int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR | O_CLOEXEC, 0666);
+        if (fd >= 0 || errno != EEXIST) {
+            return fd;
+        }
+
+        int live = 0;
+        int old = shm_open(name, O_RDONLY | O_CLOEXEC, 0);
+        if (old >= 0) {
+            struct stat st;
+            if (fstat(old, &st) == 0) {
+                uint32_t magic = 0, pid = 0;
+                if ((size_t)st.st_size >= sizeof(dotstar_shm_header)) {
+                    void *data = mmap(NULL, sizeof(dotstar_shm_header), PROT_READ, MAP_SHARED, old, 0);
+                    if (data != MAP_FAILED) {
+                        dotstar_shm_header *header = (dotstar_shm_header *) data;
+                        magic = __atomic_load_n(&header->magic, __ATOMIC_ACQUIRE);
+                        pid = header->server_pid;
+                        munmap(data, sizeof(dotstar_shm_header));
+                    }
+                }
+                if (magic == DOTSTAR_SHM_MAGIC) {
+                    live = dotstar_server_pid_alive(pid);
+                } else {
+                    live = time(NULL) - st.st_ctime < DOTSTAR_SERVER_SETUP_S;
+                }
+            }
+            close(old);
+        }
+        if (live) {
+            errno = EEXIST;
+            return -1;
+        }
+        // Left behind by a server that exited without stopping.
+        shm_unlink(name);
+    }
+    errno = EEXIST;
+    return -1;
+}
+
+dotstar_server_t * dotstar_server_start(dotstar_t * strip, const char * name)
+{
+    uint32_t num_leds = dotstar_h_num_leds(strip);
+    uint32_t slot_offset = dotstar_server_align(sizeof(dotstar_shm_header) +
+                                                DOTSTAR_SHM_SLOTS * sizeof(dotstar_shm_slot));
+    uint32_t slot_stride = dotstar_server_align(num_leds * sizeof(dotstar_rgbb));
+    size_t size = slot_offset + (size_t)DOTSTAR_SHM_SLOTS * slot_stride;
+
+    if (name == NULL) {
+        name = DOTSTAR_SHM_NAME;
+    }
+    if (num_leds == 0) {
+        printf("No strip to serve.\n");
+        return NULL;
+    }
+
+    dotstar_server_t *server = (dotstar_server_t *) calloc(1, sizeof(dotstar_server_t));
+    if (server == NULL) {
+        return NULL;
+    }
+    server->strip = strip;
+    strncpy(server->name, name, sizeof(server->name) - 1);
+    server->num_leds = num_leds;
+    server->num_slots = DOTSTAR_SHM_SLOTS;
+    server->slot_offset = slot_offset;
+    server->slot_stride = slot_stride;
+
+    int fd = dotstar_server_create(server->name);
+    if (fd < 0) {
+        if (errno == EEXIST) {
+            printf("Another frame server is running.\n");
+        } else {
+            printf("Can't create shared memory.\n");
+        }
+        free(server);
+        return NULL;
+    }
+    // Let clients running as other users in, whatever the umask.
+    fchmod(fd, 0666);
+    if (ftruncate(fd, size) < 0) {
+        printf("Can't size shared memory.\n");
+        close(fd);
+        shm_unlink(server->name);
+        free(server);
+        return NULL;
+    }
+
+    void *data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        printf("Can't map shared memory.\n");
+        shm_unlink(server->name);
+        free(server);
+        return NULL;
+    }
+
+    // The new object is zero filled, so every slot starts out FREE. The
+    // layout is published for clients; the server never reads it back.
+    server->header = (dotstar_shm_header *) data;
+    server->size = size;
+    server->header->version = DOTSTAR_SHM_VERSION;
+    server->header->num_leds = num_leds;
+    server->header->num_slots = DOTSTAR_SHM_SLOTS;
+    server->header->slot_offset = slot_offset;
+    server->header->slot_stride = slot_stride;
+    server->header->server_pid = getpid();
+    // Clients check the magic last, so they never see a partial header.
+    __atomic_store_n(&server->header->magic, DOTSTAR_SHM_MAGIC, __ATOMIC_RELEASE);
+
+    if (pthread_create(&server->thread, NULL, dotstar_server_thread, server) != 0) {
+        printf("Can't start frame server.\n");
+        munmap(data, size);
+        shm_unlink(server->name);
+        free(server);
+        return NULL;
+    }
+    return server;
+}
+
+void dotstar_server_stop(dotstar_server_t * server)
+{
+    if (server == NULL) {
+        return;
+    }
+
+    __atomic_store_n(&server->stop, 1, __ATOMIC_RELEASE);
+    __atomic_add_fetch(&server->header->doorbell, 1, __ATOMIC_RELEASE);
+    dotstar_shm_wake(&server->header->doorbell);
+    pthread_join(server->thread, NULL);
+
+    shm_unlink(server->name);
+    munmap(server->header, server->size);
+    free(server);
+}
+
+uint32_t dotstar_server_get_shown_frames(dotstar_server_t * server)
+{
+    return __atomic_load_n(&server->header->frames_shown, __ATOMIC_RELAXED);
+}
+
+uint32_t dotstar_server_get_dropped_frames(dotstar_server_t * server)
+{
+    return __atomic_load_n(&server->header->frames_dropped, __ATOMIC_RELAXED);
+}
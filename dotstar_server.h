@@ -0,0 +1,52 @@
+/*!
+ *	@file		dotstar_server.h
+ *	@author		BCA
+ *	@version	1.0.0
+ *	@date		12/2/16
+ *	@brief		Header for the Dotstar shared-memory frame server
+ *	@copyright	 Bay Computer Associates, Incorporated 2016
+				All rights reserved
+				This file contains CONFIDENTIAL material
+ *	@remark		Matilda USPS Blue Box
+ *	@Repository URL: $HeadURL: $
+ *	Last changed by: $Author: $
+ *	Last changed on: $Date: $
+ *	Revision:		$Rev: $
+**/
+#ifndef DOTSTAR_SERVER_H
+#define DOTSTAR_SERVER_H
+
+#include "dotstar.h"
+
+#include <stdint.h>
+
+/*
+The process that owns a strip can serve it to other processes. They write
+frames straight into shared memory with dotstar_client.h and a server thread
+shows the newest one. See dotstar_shm.h for the layout.
+*/
+
+typedef struct dotstar_server dotstar_server_t;
+
+/*
+@brief Create the shared memory object and start serving frames. An object
+       of the same name left by a server that has exited is replaced; if
+       its server is still running, this fails.
+
+@param strip  The strip to show frames on
+@param name  The shared memory object name, or NULL for DOTSTAR_SHM_NAME
+@return the server, or NULL if it can't be started
+*/
+dotstar_server_t * dotstar_server_start(dotstar_t * strip, const char * name);
+
+/*
+@brief Stop the server thread and remove the shared memory object. Clients
+       that still have it mapped are not affected but their frames are no
+       longer shown.
+*/
+void dotstar_server_stop(dotstar_server_t * server);
+
+uint32_t dotstar_server_get_shown_frames(dotstar_server_t * server);
+uint32_t dotstar_server_get_dropped_frames(dotstar_server_t * server);
+
+#endif
@@ -0,0 +1,110 @@
+/*!
+ *	@file		dotstar_shm.h
+ *	@author		BCA
+ *	@version	1.0.0
+ *	@date		12/2/16
+ *	@brief		Header for the Dotstar shared-memory frame layout
+ *	@copyright	 Bay Computer Associates, Incorporated 2016
+				All rights reserved
+				This file contains CONFIDENTIAL material
+ *	@remark		Matilda USPS Blue Box
+ *	@Repository URL: $HeadURL: $
+ *	Last changed by: $Author: $
+ *	Last changed on: $Date: $
+ *	Revision:		$Rev: $
+**/
+#ifndef DOTSTAR_SHM_H
+#define DOTSTAR_SHM_H
+
+#include "dotstar.h"
+
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
+/*
+Layout of the POSIX shared memory object that dotstar_server exposes and
+dotstar_client writes to. All fields are native-endian uint32_t, so other
+languages can map it as well.
+
+    offset 0                   dotstar_shm_header
+    offset sizeof(header)      num_slots dotstar_shm_slot
+    offset slot_offset         num_slots frames, slot_stride bytes apart,
+                               each num_leds dotstar_rgbb (r, g, b, brightness)
+
+A client claims a slot by moving its state from FREE to WRITING with a
+compare-and-swap, or from READY to WRITING to replace a frame the server has
+not taken yet, and stores its pid in the slot's owner. It fills the frame in
+place, stores the next doorbell value in the slot's seq, clears owner, sets
+the state to READY and wakes the futex on doorbell. The server frees a
+WRITING slot whose owner has exited.
+
+The server takes the READY slot with the newest seq, moving it to READING,
+frees older READY slots as dropped and shows the frame. When nothing is
+ready it waits on the doorbell futex.
+
+Any local process can write the object, so the server keeps its own copy
+of the layout fields and only reads slot states, seqs, owners and pixels
+from the mapping.
+*/
+
+#define DOTSTAR_SHM_NAME "/usps_bb_dotstar"
+#define DOTSTAR_SHM_MAGIC 0x4D485344u      // "DSHM"
+#define DOTSTAR_SHM_VERSION 2
+#define DOTSTAR_SHM_SLOTS 8
+#define DOTSTAR_SHM_ALIGN 64
+
+typedef enum {
+    DOTSTAR_SHM_FREE = 0,
+    DOTSTAR_SHM_WRITING = 1,
+    DOTSTAR_SHM_READY = 2,
+    DOTSTAR_SHM_READING = 3
+} dotstar_shm_state;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t num_leds;
+    uint32_t num_slots;
+    uint32_t slot_offset;
+    uint32_t slot_stride;
+    uint32_t server_pid;
+    uint32_t reserved;
+    uint32_t doorbell;          // Futex word, bumped on every publish
+    uint32_t frames_shown;      // Written by the server only
+    uint32_t frames_dropped;    // Frames replaced before they were shown
+    uint32_t pad[5];
+} dotstar_shm_header;
+
+typedef struct {
+    uint32_t state;             // dotstar_shm_state
+    uint32_t seq;               // Doorbell value when published
+    uint32_t owner;             // pid of the client while WRITING, else 0
+    uint32_t pad[13];           // One cache line per slot
+} dotstar_shm_slot;
+
+static inline dotstar_shm_slot * dotstar_shm_slots(dotstar_shm_header * header)
+{
+    return (dotstar_shm_slot *)(header + 1);
+}
+
+static inline dotstar_rgbb * dotstar_shm_frame(dotstar_shm_header * header, uint32_t slot)
+{
+    return (dotstar_rgbb *)((uint8_t *)header + header->slot_offset + slot * header->slot_stride);
+}
+
+// The object is shared between processes, so the futex calls are not
+// FUTEX_PRIVATE.
+static inline int dotstar_shm_wait(uint32_t * word, uint32_t value, const struct timespec * timeout)
+{
+    return syscall(SYS_futex, word, FUTEX_WAIT, value, timeout, NULL, 0);
+}
+
+static inline void dotstar_shm_wake(uint32_t * word)
+{
+    syscall(SYS_futex, word, FUTEX_WAKE, 1, NULL, NULL, 0);
+}
+
+#endif
@@ -0,0 +1,80 @@
+/*!
+ *	@file		lut_tables.h
+ *	@author		BCA
+ *	@version	1.0.0
+ *	@date		12/2/16
+ *	@brief		Header for lookup tables generated at build time
+ *	@copyright	 Bay Computer Associates, Incorporated 2016
+				All rights reserved
+				This file contains CONFIDENTIAL material
+ *	@remark		Matilda USPS Blue Box
+ *	@Repository URL: $HeadURL: $
+ *	Last changed by: $Author: $
+ *	Last changed on: $Date: $
+ *	Revision:		$Rev: $
+**/
+#ifndef LUT_TABLES_H
+#define LUT_TABLES_H
+
+#include <stdint.h>
+
+/*
+The tables are defined in lut_tables.c, which the Makefile generates with
+lutgen. Do not edit lut_tables.c; change lutgen.c instead.
+*/
+
+// Gamma exponent used for lut_gamma.
+#define LUT_GAMMA 2.2
+
+/*
+@brief 8-bit level to 16-bit linear intensity through a LUT_GAMMA power curve
+*/
+extern const uint16_t lut_gamma[256];
+
+/*
+@brief 8-bit level, treated as CIE 1976 lightness L* 0-100, to 16-bit linear
+       intensity
+*/
+extern const uint16_t lut_cie[256];
+
+/*
+The tables below have LUT_INTERP_SIZE entries. Entry i holds the curve at
+i/256, so lut_interp() can look up a full 16-bit input by interpolating
+between neighbours.
+*/
+#define LUT_INTERP_SIZE 257
+
+/*
+@brief 16-bit CIE 1976 lightness L* (0-100) to 16-bit linear intensity
+*/
+extern const uint16_t lut_lightness[LUT_INTERP_SIZE];
+
+/*
+@brief Easing curves, 16-bit time fraction to 16-bit progress. Cubic ease
+       in, cubic ease out, cubic ease in and out, and sine ease in and out.
+*/
+extern const uint16_t lut_ease_in[LUT_INTERP_SIZE];
+extern const uint16_t lut_ease_out[LUT_INTERP_SIZE];
+extern const uint16_t lut_ease_in_out[LUT_INTERP_SIZE];
+extern const uint16_t lut_ease_sine[LUT_INTERP_SIZE];
+
+/*
+@brief Look up x (0-65535) in a LUT_INTERP_SIZE table.
+
+@return the interpolated value with 8 fraction bits, 0 to 65535 * 256. The
+        extra bits keep the steps between small table values.
+*/
+static inline uint32_t lut_interp(const uint16_t * lut, uint16_t x)
+{
+    // Stretch 0-65535 to 0-65536 so the last input lands on the last entry.
+    uint32_t pos = x + (x >> 15);
+    uint32_t i = pos >> 8;
+    uint32_t frac = pos & 0xFF;
+
+    if (i >= LUT_INTERP_SIZE - 1) {
+        return (uint32_t)lut[LUT_INTERP_SIZE - 1] << 8;
+    }
+    return ((uint32_t)lut[i] << 8) + (int32_t)(lut[i + 1] - lut[i]) * (int32_t)frac;
+}
+
+#endif
@@ -0,0 +1,86 @@
+/*!
+ *	@file		lutgen.c
+ *	@author		BCA
+ *	@version	1.0.0
+ *	@date		12/2/16
+ *	@brief		Build-time generator for lut_tables.c
+ *	@copyright	 Bay Computer Associates, Incorporated 2016
+				All rights reserved
+				This file contains CONFIDENTIAL material
+ *	@remark		Matilda USPS Blue Box
+ *	@Repository URL: $HeadURL: $
+ *	Last changed by: $Author: $
+ *	Last changed on: $Date: $
+ *	Revision:		$Rev: $
+**/
+
+// Runs on the build host and writes the tables declared in lut_tables.h to
+// stdout. The Makefile builds it with HOSTCC and redirects the output to
+// lut_tables.c.
+
+#include "lut_tables.h"
+#include <stdio.h>
+#include <math.h>
+
+// CIE 1976 lightness L* (0-100) to relative luminance Y (0-1).
+static double cie_to_linear(double l)
+{
+    if (l <= 8.0) {
+        return l / 903.3;
+    }
+    return pow((l + 16.0) / 116.0, 3.0);
+}
+
+static void print_table(const char * name, double (*curve)(double), int size)
+{
+    printf("const uint16_t %s[%d] = {", name, size);
+    for (int i = 0; i < size; i++) {
+        double value = curve((double)i / (size - 1)) * 65535.0 + 0.5;
+        printf("%s%5u,", (i % 8) ? " " : "\n    ", (unsigned)value);
+    }
+    printf("\n};\n\n");
+}
+
+static double gamma_curve(double x)
+{
+    return pow(x, LUT_GAMMA);
+}
+
+static double cie_curve(double x)
+{
+    return cie_to_linear(x * 100.0);
+}
+
+static double ease_in_curve(double x)
+{
+    return x * x * x;
+}
+
+static double ease_out_curve(double x)
+{
+    return 1.0 - ease_in_curve(1.0 - x);
+}
+
+static double ease_in_out_curve(double x)
+{
+    return (x < 0.5) ? 4.0 * x * x * x : 1.0 - 4.0 * pow(1.0 - x, 3.0);
+}
+
+static double ease_sine_curve(double x)
+{
+    return 0.5 - 0.5 * cos(M_PI * x);
+}
+
+int main()
+{
+    printf("// Generated by lutgen. Do not edit.\n\n");
+    printf("#include \"lut_tables.h\"\n\n");
+    print_table("lut_gamma", gamma_curve, 256);
+    print_table("lut_cie", cie_curve, 256);
+    print_table("lut_lightness", cie_curve, LUT_INTERP_SIZE);
+    print_table("lut_ease_in", ease_in_curve, LUT_INTERP_SIZE);
+    print_table("lut_ease_out", ease_out_curve, LUT_INTERP_SIZE);
+    print_table("lut_ease_in_out", ease_in_out_curve, LUT_INTERP_SIZE);
+    print_table("lut_ease_sine", ease_sine_curve, LUT_INTERP_SIZE);
+    return 0;
+}
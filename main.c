@@ -26,6 +26,12 @@
  				./test backlight [brightness [grayscale]]
  		@endverbatim
  *				Set backlight brightness (0-127) and grayscale (0-65535).
+ *	@subsection backlight_channel_subsection Backlight Channel
+ *		@verbatim
+ 				./test backlightChannel channel [grayscale [brightness]]
+ 		@endverbatim
+ *				Set one channel of the backlight chain (0-65535, default
+ *				65535) and the brightness of its chip (0-127, default 127).
  *	@subsection backlight_blink_subsection Backlight Blink
  *		@verbatim
  				./test backlightBlink [onMS [offMS [count]]]
@@ -34,21 +40,70 @@
  *				is 3.
  *	@subsection backlight_pulsegs_subsection Backlight PulseGS
  *		@verbatim
- 				./test backlightPulseGS [durationMS]
+ 				./test backlightPulseGS [durationMS [ease]]
  		@endverbatim
  *				Pulse backlight grayscale 5 times.  Default durationMS is 1000.
+ *				ease is linear, in, out, inOut or sine, default sine.
  *	@subsection backlight_pulse_subsection Backlight Pulse
  *		@verbatim
- 				./test backlightPulse [durationMS]
+ 				./test backlightPulse [durationMS [ease]]
  		@endverbatim
  *				Pulse backlight brightness 5 times.  Default durationMS is 1000.
+ *				ease is linear, in, out, inOut or sine, default sine.
+ *	@subsection backlight_anim_subsection Backlight Anim
+ *		@verbatim
+ 				./test backlightAnim [preemptMS]
+ 		@endverbatim
+ *				Queue a fade, blinks and an endless pulse on the backlight
+ *				animator, then preempt them with a fade to off after
+ *				preemptMS.  Default preemptMS is 6000.
+ *	@subsection backlight_backlightbench_subsection Backlight Bench
+ *		@verbatim
+ 				./test backlightBench [iterations]
+ 		@endverbatim
+ *				Time the backlight update path against a mock spi device.
+ *				Default iterations is 100000.  The backlight is not used.
  *	@subsection backlight_dotstar_subsection Dotstar
  *		@verbatim
- 				./test dotstar [test]
+ 				./test dotstar [test [async [fps [seconds]]]]
  		@endverbatim
  *				Test the LED strip.  Default test is 0.
  *					- 0 fade brightness
  *					- 1 rotate
+ *					- 2 transitions: crossfade, wipe and dissolve between
+ *					  two frames, 1 second each.  seconds is the number of
+ *					  rounds (default 1).
+ *					.
+ *				A nonzero async sends frames from a writer thread.  Frames
+ *				run at fps (default 100) for seconds (default 0, forever),
+ *				then the frame timing is printed.
+ *	@subsection backlight_dotstarclip_subsection Dotstar Clip
+ *		@verbatim
+ 				./test dotstarClip file [async [loops]]
+ 		@endverbatim
+ *				Play a clip built by clipgen at its own frame rate.  loops
+ *				defaults to 1.  A nonzero async sends frames from a writer
+ *				thread.
+ *	@subsection backlight_dotstarserve_subsection Dotstar Serve
+ *		@verbatim
+ 				./test dotstarServe [seconds]
+ 		@endverbatim
+ *				Open the strip and show frames written by other processes
+ *				through shared memory for seconds (default 60).  The frame
+ *				counts are printed every second.
+ *	@subsection backlight_dotstarclient_subsection Dotstar Client
+ *		@verbatim
+ 				./test dotstarClient [fps [seconds]]
+ 		@endverbatim
+ *				Run a moving dot on a strip served by dotstarServe in another
+ *				process.  Default fps is 100 and seconds is 10.
+ *	@subsection backlight_dotstarbench_subsection Dotstar Bench
+ *		@verbatim
+ 				./test dotstarBench [count [iterations]]
+ 		@endverbatim
+ *				Time the pixel kernels on count pixels (default 240) and
+ *				compare the scalar and NEON versions.  Default iterations is
+ *				10000.  The strip is not used.
  *	@subsection backlight_displayinit_subsection Display Init
  *		@verbatim
  				./test displayInit
@@ -76,6 +131,13 @@
  *					- 3 on, 0.5 Hz blink
  *					- 4 off
  *					.
+ *	@subsection backlight_displayweight_subsection Display Weight
+ 		@verbatim
+ 				./test displayWeight [seconds]
+ 		@endverbatim
+ *				Show a drifting weight readout at 20 Hz for seconds (default
+ *				10), then print the i2c bytes sent and what full refreshes
+ *				would have cost.
  *	@section	api_section API
  *				@ref usps_bb.api.h and @ref usps_bb_api.c contains the API to
  *				be used by the application.
@@ -85,7 +147,13 @@
 #include "usps_bb_api.h"
 #include "ProjectConfig.h"
 #include "Backlight.h"
+#include "BacklightAnim.h"
 #include "dotstar.h"
+#include "dotstar_anim.h"
+#include "dotstar_clip.h"
+#include "dotstar_client.h"
+#include "dotstar_server.h"
+#include "dotstar_kernels.h"
 #include "SegmentDisplay.h"
 
 #include <stdlib.h>
@@ -112,14 +180,22 @@ typedef void (*usps_bb_wrapper)(int argc,const char * argv[]);
 	WRAPPER_( "api1"				,wrapper1					)\
 	WRAPPER_( "api2"				,wrapper2					)\
 	WRAPPER_( "backlight"			,wrapperBacklight			)\
+	WRAPPER_( "backlightChannel"	,wrapperBacklightChannel	)\
 	WRAPPER_( "backlightBlink"		,wrapperBacklightBlink		)\
 	WRAPPER_( "backlightPulseGS"	,wrapperBacklightPulseGS	)\
 	WRAPPER_( "backlightPulse"		,wrapperBacklightPulse		)\
+	WRAPPER_( "backlightAnim"		,wrapperBacklightAnim		)\
+	WRAPPER_( "backlightBench"		,wrapperBacklightBench		)\
 	WRAPPER_( "dotstar"				,wrapperDotstar				)\
+	WRAPPER_( "dotstarClip"			,wrapperDotstarClip			)\
+	WRAPPER_( "dotstarServe"		,wrapperDotstarServe		)\
+	WRAPPER_( "dotstarClient"		,wrapperDotstarClient		)\
+	WRAPPER_( "dotstarBench"		,wrapperDotstarBench		)\
 	WRAPPER_( "displayInit"			,wrapperDisplayInit			)\
 	WRAPPER_( "displayText"			,wrapperDisplayText			)\
 	WRAPPER_( "displayBrightness"	,wrapperDisplayBrightness	)\
 	WRAPPER_( "displayBlink"		,wrapperDisplayBlink	)\
+	WRAPPER_( "displayWeight"		,wrapperDisplayWeight	)\
 //Comment terminates list macro. Do not delete.
 
 //Ouput command function prototypes.
@@ -162,22 +238,8 @@ void playback_callback(snd_async_handler_t *handler);
 void capture_callback(snd_async_handler_t *handler);
 
 //Backlight animating functions.
-#define ANIMATION_INC_MS 17
-
-BacklightErrEnum BacklightAnimateBrightness(
-	BacklightBrightness start, 
-	BacklightBrightness end, 
-	uint32_t durationMS,
-	bool skipFirst);
-BacklightErrEnum BacklightAnimateGrayscale(
-	BacklightGrayscale start, 
-	BacklightGrayscale end, 
-	uint32_t durationMS,
-	bool skipFirst);
-BacklightErrEnum BacklightBlink(
-	BacklightBrightness brightness, 
-	BacklightGrayscale grayscale, 
-	uint32_t onMS, uint32_t offMS, int blinkCount);
+BacklightErrEnum BacklightAnimWait(void);
+BacklightEaseEnum BacklightEaseParse(const char *name);
 
 /*!
  *	@brief		main
@@ -222,6 +284,9 @@ int main(
 	} while(current - start < 1*USEC_PER_SECOND);
 
 	done_audio();
+	BacklightAnimStop();
+	BacklightClose();
+	SegDispClose();
 
 	return 0;
 }
@@ -389,6 +454,68 @@ void wrapperDisplayBlink(
 	usps_bb_display_blink(rate1, rate2);
 }
 
+/*!
+*	@brief		displayWeight [seconds]
+*	@details
+The command shows a weight readout that drifts the way a scale does,
+updating the display 20 times a second for seconds (default 10). Only the
+characters that change are sent, so at the end the i2c bytes sent are
+printed beside the bytes full refreshes of both LEDs would have taken.
+*/
+void wrapperDisplayWeight(
+	int argc,
+	const char * argv[])
+{
+	//A full refresh is a slave address, the write command and 4 two-byte
+	// characters for each LED.
+	const uint32_t	fullBytes = 2 * (2 + 4 * sizeof(SegDispBitmask));
+	struct timespec	deadline;
+	SegDispErrEnum	err;
+	char			text[16];
+	uint32_t		startBytes;
+	int				seconds = 10;
+	int				updates;
+	int				i;
+	double			weight = 12.50;
+
+	if (argc > 2)
+	{
+		seconds = atoi(argv[2]);
+	}
+	updates = seconds * 20;
+
+	startBytes = SegDispGetBytesSent();
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+	for (i = 0; i < updates; i++)
+	{
+		if (0 == rand() % 4)
+		{
+			weight += (rand() % 21 - 10) * 0.01;
+		}
+		snprintf(text, sizeof(text), "%6.2f lb", weight);
+		err = SegDispText(0, text, strlen(text));
+		if (SegDispNoErr == err)
+		{
+			err = SegDispUpdate();
+		}
+		if (SegDispNoErr != err)
+		{
+			printf("Display: %s\n", SegDispErrDesc(err));
+			return;
+		}
+
+		deadline.tv_nsec += 50000000;
+		if (deadline.tv_nsec >= 1000000000)
+		{
+			deadline.tv_nsec -= 1000000000;
+			deadline.tv_sec++;
+		}
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL);
+	}
+	printf("updates=%d bytes=%u full refresh bytes=%u\n", updates,
+		SegDispGetBytesSent() - startBytes, updates * fullBytes);
+}
+
 /*!
  *	@brief		backlight [brightness [grayscale]] 
  *	@details
@@ -429,6 +556,56 @@ void wrapperBacklight(
 	usps_bb_backlight_show();
 }
 
+/*!
+ *	@brief		backlightChannel channel [grayscale [brightness]] 
+ *	@details
+ The command sets one output of the backlight chain, which is useful for
+ finding which channel drives which panel. Channels are numbered R0, G0, B0,
+ R1 ... B3 on the first chip and on through the chain, BACKLIGHT_CHANNELS in
+ all. Other channels keep their values.
+
+ The grayscale parameter is optional. The default is 65535.
+
+ The brightness parameter is optional and may be used in addition to the
+ grayscale parameter. The default is 127. It is set for every color of the
+ channel's chip.
+**/
+void wrapperBacklightChannel(
+	int argc,
+	const char * argv[])
+{
+	BacklightErrEnum	err;
+	BacklightGrayscale	grayscale = BACKLIGHT_GRAYSCALE_MAX;
+	BacklightBrightness	brightness = BACKLIGHT_BRIGHTNESS_MAX;
+	uint16_t			channel;
+
+	if (argc < 3)
+	{
+		printf("usage: backlightChannel channel [grayscale [brightness]]\n");
+		return;
+	}
+	channel = atoi(argv[2]);
+	if (argc > 3)
+	{
+		grayscale = atoi(argv[3]);
+		if (argc > 4)
+		{
+			brightness = atoi(argv[4]);
+		}
+	}
+
+	err = SetChipBrightness(channel / BACKLIGHT_CHANNELS_PER_CHIP,
+		brightness, brightness, brightness, false);
+	if (BacklightNoErr == err)
+	{
+		err = SetChannelGrayscale(channel, 1, &grayscale, true);
+	}
+	if (BacklightNoErr != err)
+	{
+		printf("Backlight channel %u of %u: %s\n", channel, BACKLIGHT_CHANNELS, BacklightErrDesc(err));
+	}
+}
+
 /*!
  *	@brief		backlightBlink [onMS [offMS [count]]] 
  *	@details
@@ -446,15 +623,15 @@ void wrapperBacklight(
  The count parameter is optional and may be used in addition to the onMS and offMS
  parameters. The default is 3. If supplied, the value is the number of blink cycles.
 
- NOTE that this function yields to other threads, but blocks the main thread until
- it completes. That amount of time is (onMS + offMS) * count. An application would
- typically run similar code in a separate thread.
+ The blink runs on the backlight animator thread. This command waits for it,
+ which takes (onMS + offMS) * count. An application would not wait.
 **/
 void wrapperBacklightBlink(
 	int argc,
 	const char * argv[])
 {
 	BacklightErrEnum	err;
+	BacklightLevel		on = {BACKLIGHT_BRIGHTNESS_MAX, BACKLIGHT_GRAYSCALE_MAX};
 	uint32_t			onMS = 1 * MSECS_PER_SECOND;
 	uint32_t			offMS = 1 * MSECS_PER_SECOND;
 	int					blinkCount = 3;
@@ -471,8 +648,11 @@ void wrapperBacklightBlink(
 			}
 		}
 	}
-	err = BacklightBlink( BACKLIGHT_BRIGHTNESS_MAX, BACKLIGHT_GRAYSCALE_MAX, 
-							onMS, offMS, blinkCount);
+	err = BacklightAnimBlink(on, onMS, offMS, blinkCount, BacklightAnimPreempt, NULL);
+	if (BacklightNoErr == err)
+	{
+		err = BacklightAnimWait();
+	}
 	if (BacklightNoErr != err)
 	{
 		printf("Backlight blink: %s\n", BacklightErrDesc(err));
@@ -481,7 +661,7 @@ void wrapperBacklightBlink(
 
 
 /*!
- *	@brief		backlightPulse [durationMS] 
+ *	@brief		backlightPulse [durationMS [ease]] 
  *	@details
  The command animates the backlight LED by pulsing it from its minimum to its
  maximum brightness five times.
@@ -489,93 +669,248 @@ void wrapperBacklightBlink(
  The durationMS parameter is optional. The default is 1000. If supplied, the value
  is the number of milliseconds for each cycle.
 
- NOTE that this function yields to other threads, but blocks the main thread until
- it completes. That amount of time is durationMS * 5. An application would
- typically run similar code in a separate thread.
+ The ease parameter is optional and may be used in addition to the durationMS
+ parameter. The default is sine. If supplied, it names a curve in
+ BACKLIGHT_EASE_LIST: linear, in, out, inOut or sine.
+
+ The pulses run on the backlight animator thread. This command waits for them,
+ which takes durationMS * 5. An application would not wait.
 **/
 void wrapperBacklightPulse(
 	int argc,
 	const char * argv[])
 {
 	BacklightErrEnum	err;
-	int					i;
+	BacklightLevel		low = {BACKLIGHT_BRIGHTNESS_MIN, GetGrayscale1()};
+	BacklightLevel		high = {BACKLIGHT_BRIGHTNESS_MAX, GetGrayscale1()};
+	BacklightEaseEnum	ease = BacklightEaseSine;
 	int					durationMS = 1000;
 
 	if (argc > 2)
 	{
 		durationMS = atoi(argv[2]);
+		if (argc > 3)
+		{
+			ease = BacklightEaseParse(argv[3]);
+		}
 	}
 
-	for (i = 0; i < 5; i++)
+	err = BacklightAnimPulse(low, high, durationMS, 5, ease, BacklightAnimPreempt, NULL);
+	if (BacklightNoErr == err)
 	{
-		err = BacklightAnimateBrightness(BACKLIGHT_BRIGHTNESS_MIN, BACKLIGHT_BRIGHTNESS_MAX, 
-			durationMS / 2, false);
-		if (BacklightNoErr != err)
-		{
-			printf("Fade brightness: %s\n", BacklightErrDesc(err));
-			break;
-		}
-		err = BacklightAnimateBrightness(BACKLIGHT_BRIGHTNESS_MAX, BACKLIGHT_BRIGHTNESS_MIN, 
-			durationMS - (durationMS / 2), true);
-		if (BacklightNoErr != err)
-		{
-			printf("Fade brightness: %s\n", BacklightErrDesc(err));
-			break;
-		}
+		err = BacklightAnimWait();
+	}
+	if (BacklightNoErr != err)
+	{
+		printf("Fade brightness: %s\n", BacklightErrDesc(err));
 	}
 }
 
 /*!
- *	@brief		backlightPulseGS [durationMS] 
+ *	@brief		backlightPulseGS [durationMS [ease]] 
  *	@details
  The command animates the backlight LED by pulsing it from its minimum to its
  maximum grayscale five times. This function is essentially identical to the
- backlightPulse command, but animates the grayscale value, rather than the 
- brightness value.
+ backlightPulse command, but pulses between levels set by the grayscale value,
+ rather than the brightness value.
 
  The durationMS parameter is optional. The default is 1000. If supplied, the value
  is the number of milliseconds for each cycle.
 
- NOTE that this function yields to other threads, but blocks the main thread until
- it completes. That amount of time is durationMS * 5. An application would
- typically run similar code in a separate thread.
+ The ease parameter is optional and may be used in addition to the durationMS
+ parameter. The default is sine.
+
+ The pulses run on the backlight animator thread. This command waits for them,
+ which takes durationMS * 5. An application would not wait.
 **/
 void wrapperBacklightPulseGS(
 	int argc,
 	const char * argv[])
 {
 	BacklightErrEnum	err;
-	int					i;
+	BacklightLevel		low = {GetBrightness1(), BACKLIGHT_GRAYSCALE_MIN};
+	BacklightLevel		high = {GetBrightness1(), BACKLIGHT_GRAYSCALE_MAX};
+	BacklightEaseEnum	ease = BacklightEaseSine;
 	int					durationMS = 1000;
 
 	if (argc > 2)
 	{
 		durationMS = atoi(argv[2]);
+		if (argc > 3)
+		{
+			ease = BacklightEaseParse(argv[3]);
+		}
+	}
+
+	err = BacklightAnimPulse(low, high, durationMS, 5, ease, BacklightAnimPreempt, NULL);
+	if (BacklightNoErr == err)
+	{
+		err = BacklightAnimWait();
+	}
+	if (BacklightNoErr != err)
+	{
+		printf("Fade grayscale: %s\n", BacklightErrDesc(err));
+	}
+}
+
+/*!
+ *	@brief		backlightAnim [preemptMS]
+ *	@details
+ The command shows the backlight animator's command queue. It queues a one
+ second fade up, three quick blinks and a pulse that repeats forever, and each
+ call returns at once. It prints each command id as it starts. After preemptMS
+ (default 6000) a half second fade to off preempts whatever is running.
+**/
+void wrapperBacklightAnim(
+	int argc,
+	const char * argv[])
+{
+	const struct timespec	timeDelay = {0, 10 * NSEC_PER_MSECS};
+	BacklightLevel			off = {BACKLIGHT_BRIGHTNESS_MIN, BACKLIGHT_GRAYSCALE_MAX};
+	BacklightLevel			full = {BACKLIGHT_BRIGHTNESS_MAX, BACKLIGHT_GRAYSCALE_MAX};
+	BacklightLevel			half = {BACKLIGHT_BRIGHTNESS_MAX / 2, BACKLIGHT_GRAYSCALE_MAX};
+	BacklightAnimId			ids[4];
+	BacklightAnimId			current;
+	BacklightAnimId			shown = 0;
+	BacklightErrEnum		err;
+	struct timespec			start;
+	struct timespec			now;
+	uint32_t				preemptMS = 6000;
+	uint32_t				elapsedMS;
+
+	if (argc > 2)
+	{
+		preemptMS = atoi(argv[2]);
 	}
 
-	for (i = 0; i < 5; i++)
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	err = BacklightAnimFade(off, 0, BacklightEaseLinear, BacklightAnimPreempt, NULL);
+	if (BacklightNoErr == err)
+		err = BacklightAnimFade(full, 1000, BacklightEaseInOut, BacklightAnimQueue, &ids[0]);
+	if (BacklightNoErr == err)
+		err = BacklightAnimBlink(full, 150, 150, 3, BacklightAnimQueue, &ids[1]);
+	if (BacklightNoErr == err)
+		err = BacklightAnimPulse(half, full, 1000, 0, BacklightEaseSine, BacklightAnimQueue, &ids[2]);
+	if (BacklightNoErr != err)
 	{
-		err = BacklightAnimateGrayscale(BACKLIGHT_GRAYSCALE_MIN, BACKLIGHT_GRAYSCALE_MAX, 
-			durationMS / 2, false);
-		if (BacklightNoErr != err)
+		printf("Backlight anim: %s\n", BacklightErrDesc(err));
+		return;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	printf("queued fade %u, blink %u, pulse %u in %ld us\n", ids[0], ids[1], ids[2],
+		(now.tv_sec - start.tv_sec) * USEC_PER_SECOND + (now.tv_nsec - start.tv_nsec) / 1000);
+
+	do
+	{
+		current = BacklightAnimCurrent();
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		elapsedMS = (now.tv_sec - start.tv_sec) * MSECS_PER_SECOND +
+			(now.tv_nsec - start.tv_nsec) / NSEC_PER_MSECS;
+		if (current != shown)
 		{
-			printf("Fade grayscale: %s\n", BacklightErrDesc(err));
-			break;
+			printf("%5u ms: running %u\n", elapsedMS, current);
+			shown = current;
 		}
-		err = BacklightAnimateGrayscale(BACKLIGHT_GRAYSCALE_MAX, BACKLIGHT_GRAYSCALE_MIN, 
-			durationMS - (durationMS / 2), true);
-		if (BacklightNoErr != err)
-		{
-			printf("Fade grayscale: %s\n", BacklightErrDesc(err));
-			break;
+		nanosleep(&timeDelay, NULL);
+	} while (elapsedMS < preemptMS);
+
+	err = BacklightAnimFade(off, 500, BacklightEaseOut, BacklightAnimPreempt, &ids[3]);
+	if (BacklightNoErr == err)
+	{
+		printf("%5u ms: fade %u preempts %u\n", elapsedMS, ids[3], shown);
+		err = BacklightAnimWait();
+	}
+	if (BacklightNoErr != err)
+	{
+		printf("Backlight anim: %s\n", BacklightErrDesc(err));
+	}
+}
+
+//Mock spi device for backlightBench. It copies each packet, as spidev would.
+static int backlightBenchTransfer(
+	const uint8_t *packet,
+	uint32_t length,
+	void *context)
+{
+	static uint8_t sWire[BACKLIGHT_PACKET_BYTES];
+
+	if(length>sizeof(sWire))
+		return -1;
+	memcpy(sWire,packet,length);
+	(*(uint32_t *)context)++;
+	return length;
+}
+
+/*!
+ *	@brief		backlightBench [iterations]
+ *	@details
+ Times the backlight update path with the spi device replaced by a mock
+ that copies each packet, as the spidev driver would. Each case is a Set
+ call with update true and the combine window off, so every call runs the
+ whole path to the transfer. The cases are a grayscale change, a
+ brightness change, one channel of the chain, and an update that changes
+ nothing. The average time per call and the number of packets the mock
+ received are printed. The default iterations is 100000. The backlight is
+ not touched.
+ *	@param		[in] argc: int argument count
+ *	@param		[in] argv: const char * argv[]
+ *	@retval		none
+ *	@test
+**/
+
+void wrapperBacklightBench(
+	int argc,
+	const char * argv[])
+{
+	static const char *names[]={"grayscale","brightness","channel","unchanged"};
+	uint32_t window=BacklightGetCombineWindow();
+	uint32_t packets;
+	uint32_t iterations=100000;
+	struct timespec startTime,endTime;
+	BacklightGrayscale grayscale;
+	uint32_t i;
+	size_t k;
+
+	if(argc>2)
+		iterations=atoi(argv[2]);
+	printf("backlightBench iterations=%u chips=%d\n",iterations,BACKLIGHT_CHIPS);
+
+	BacklightSetCombineWindow(0);
+	BacklightSetTransferHook(backlightBenchTransfer,&packets);
+	for(k=0;k<ARRAY_SIZE(names);k++) {
+		packets=0;
+		clock_gettime(CLOCK_MONOTONIC,&startTime);
+		for(i=0;i<iterations;i++) {
+			switch(k) {
+				case 0: SetGrayscale(i,~i,true); break;
+				case 1: SetBrightness(i&BACKLIGHT_BRIGHTNESS_MAX,~i&BACKLIGHT_BRIGHTNESS_MAX,true); break;
+				case 2:
+					grayscale=i;
+					SetChannelGrayscale(i%BACKLIGHT_CHANNELS,1,&grayscale,true);
+					break;
+				case 3: SetGrayscale(0,0,true); break;
+			}
 		}
+		clock_gettime(CLOCK_MONOTONIC,&endTime);
+		printf("%-10s %8.1f ns/update %8u packets\n",names[k],
+			((endTime.tv_sec-startTime.tv_sec)*1e9+(endTime.tv_nsec-startTime.tv_nsec))/iterations,
+			packets);
 	}
+	BacklightSetTransferHook(NULL,NULL);
+	BacklightSetCombineWindow(window);
 }
 
 /*!
- *	@brief		dotstar [test]
+ *	@brief		dotstar [test [async [fps [seconds]]]]
  *	@details
- test is either 0 (fade brightness) or 1 (rotate)
+ test is 0 (fade brightness), 1 (rotate), 2 (transitions) or 3 (queue
+ check). The queue check fills a depth 1 DOTSTAR_QUEUE_DROP_NEWEST queue
+ until a frame is dropped, then checks that the next show with no pixel
+ change still writes the dropped state. It always runs asynchronously.
+ async is optional. If nonzero, frames are sent from the dotstar writer thread
+ so each step is rendered while the previous one is on the wire.
+ fps is the frame rate, default 100. seconds is how long to run, default 0
+ which runs forever. When the test ends the frame timing is printed.
  *	@param		[in] argc: int argument count
  *	@param		[in] argv: const char * argv[]
  *	@retval		none
@@ -589,66 +924,343 @@ void wrapperDotstar(
 	const int cNumLEDs=80;
 	const int cCenter=5;
 	int test=0;
+	int async=0;
+	int fps=100;
+	int seconds=0;
 	int i;
-	struct timespec tim;
-	tim.tv_sec=0;
-	tim.tv_nsec=1000*10000;
+	dotstar_t *strip;
+	dotstar_anim_stats stats;
+	dotstar_effect_fade_t fade={0,0,255,15,2};
+	dotstar_effect_rotate_t rotate={cNumLEDs-cCenter,0};
+	dotstar_transition_t transition;
+	uint32_t frameA[cNumLEDs],frameB[cNumLEDs];
+	uint32_t sent,dropped;
 
 	if(argc>2)
 		test=atoi(argv[2]);
-	printf("dotstar test=%d\n",test);
-
-	dotstar_create("/dev/spidev1.0", 5000000, cNumLEDs);
-
-    // Initialization for the tests
-    switch(test) {
-    case 0:
-        break;
-    case 1:
-        dotstar_set_strip(0,0,0,0);
-        for (i = 0; i < cCenter; i++) {
-            dotstar_strip_push_pixel_front(255,255,0,15);
-        }
-        break;
-    default:
-        break;
-    }
-
-	dotstar_show();
-
-	while(1) {
-		switch(test) {
-			case 0:
-          			for (i = 0; i < 256; i+=2) {
-                			dotstar_set_strip(0, 0, i, 15);
-                			dotstar_show();
-                			nanosleep(&tim, NULL);
-            			}
-            			for (i = 255; i > 0; i-=2) {
-               				dotstar_set_strip(0, 0, i, 15);
-                			dotstar_show();
-               				nanosleep(&tim, NULL);
-           			}
+	if(argc>3)
+		async=atoi(argv[3]);
+	if(argc>4)
+		fps=atoi(argv[4]);
+	if(argc>5)
+		seconds=atoi(argv[5]);
+	printf("dotstar test=%d async=%d fps=%d seconds=%d\n",test,async,fps,seconds);
+
+	if(dotstar_create("/dev/spidev1.0", 5000000, cNumLEDs)!=0)
+		return;
+	strip=dotstar_get_default();
+	dotstar_set_async(async);
+
+	switch(test) {
+	case 0:
+		// Fade in perceived lightness with dithering for the low levels.
+		dotstar_set_curve(DOTSTAR_CURVE_CIE);
+		dotstar_set_dither(1);
+		dotstar_anim_run(strip,fps,fps*seconds,dotstar_effect_fade,&fade,&stats);
+		break;
+	case 1:
+		dotstar_set_strip(0,0,0,0);
+		for (i = 0; i < cCenter; i++) {
+			dotstar_strip_push_pixel_front(255,255,0,15);
+		}
+		dotstar_show();
+		dotstar_anim_run(strip,fps,fps*seconds,dotstar_effect_rotate,&rotate,&stats);
+		break;
+	case 2:
+		dotstar_kernels->gradient(frameA,cNumLEDs,dotstar_kernel_pixel(255,0,0,15),
+			dotstar_kernel_pixel(0,0,255,15),0,cNumLEDs);
+		dotstar_kernels->fill(frameB,cNumLEDs,dotstar_kernel_pixel(0,255,64,8));
+		dotstar_set_pixels_packed(0,cNumLEDs,frameA);
+		dotstar_show();
+		// Each transition goes to B and back.
+		for(i=0;i<3*(seconds?seconds:1);i++) {
+			dotstar_transition_type type=(dotstar_transition_type)(i%3);
+			if(dotstar_transition_begin(&transition,strip,type,frameB,1000,fps)!=0)
 				break;
-			case 1:
-           			for (i = 0; i < cNumLEDs-cCenter; i++) {
-           				dotstar_strip_rotate_right();
-               				dotstar_show();
-                			nanosleep(&tim, NULL);
-            			}
-            			for (i = 0; i < cNumLEDs-cCenter; i++) {
-                			dotstar_strip_rotate_left();
-                			dotstar_show();
-                			nanosleep(&tim, NULL); }
+			dotstar_anim_run(strip,fps,transition.frames,dotstar_transition_render,&transition,&stats);
+			dotstar_transition_end(&transition);
+			if(dotstar_transition_begin(&transition,strip,type,frameA,1000,fps)!=0)
 				break;
-			default:
+			dotstar_anim_run(strip,fps,transition.frames,dotstar_transition_render,&transition,&stats);
+			dotstar_transition_end(&transition);
+		}
+		break;
+	case 3:
+		memset(&stats,0,sizeof(stats));
+		dotstar_set_async(1);
+		dotstar_set_queue(1,DOTSTAR_QUEUE_DROP_NEWEST);
+		// Show faster than the writer until the last frame is dropped.
+		for(i=0;i<1000;i++) {
+			dotstar_set_pixel(0,i&255,0,0,15);
+			dotstar_show();
+			dotstar_set_pixel(0,0,i&255,0,15);
+			dotstar_show();
+			dropped=dotstar_get_dropped_frames();
+			dotstar_set_pixel(0,0,0,255,15);
+			dotstar_show();
+			if(dotstar_get_dropped_frames()!=dropped)
 				break;
 		}
+		dotstar_wait();
+		if(i==1000) {
+			printf("queue check: no frame was dropped\n");
+			break;
+		}
+		sent=dotstar_get_sent_frames();
+		dotstar_show();
+		dotstar_wait();
+		printf("queue check %s: tries=%d sent=%u dropped=%u\n",
+			dotstar_get_sent_frames()==sent+1?"PASS":"FAIL",i+1,
+			dotstar_get_sent_frames(),dotstar_get_dropped_frames());
+		break;
+	default:
+		memset(&stats,0,sizeof(stats));
+		break;
 	}
 
+	dotstar_wait();
+	printf("shown=%u skipped=%u jitter max=%uus mean=%uus dropped=%u\n",
+		stats.frames_shown,stats.frames_skipped,stats.jitter_max_us,
+		stats.jitter_mean_us,dotstar_get_dropped_frames());
+	dotstar_destroy();
+}
+
+/*!
+ *	@brief		dotstarClip file [async [loops]]
+ *	@details
+ Plays a clip file on the strip. The clip is mapped rather than read, and
+ each frame is decoded straight into the strip buffer.
+ *	@param		[in] argc: int argument count
+ *	@param		[in] argv: const char * argv[]
+ *	@retval		none
+ *	@test
+**/
+
+void wrapperDotstarClip(
+	int argc,
+	const char * argv[])
+{
+	dotstar_clip clip;
+	dotstar_anim_stats stats;
+	int async=0;
+	int loops=1;
+	int i;
+
+	if(argc<3) {
+		printf("Enter a clip file.\n");
+		return;
+	}
+	if(argc>3)
+		async=atoi(argv[3]);
+	if(argc>4)
+		loops=atoi(argv[4]);
+
+	if(dotstar_clip_open(&clip,argv[2])!=0)
+		return;
+	printf("dotstarClip frames=%u fps=%u async=%d loops=%d\n",
+		dotstar_clip_num_frames(&clip),dotstar_clip_fps(&clip),async,loops);
+
+	if(dotstar_create("/dev/spidev1.0", 8000000, clip.header->num_leds)!=0) {
+		dotstar_clip_close(&clip);
+		return;
+	}
+	dotstar_set_async(async);
+
+	for(i=0;i<loops;i++) {
+		dotstar_anim_run(dotstar_get_default(),dotstar_clip_fps(&clip),
+			dotstar_clip_num_frames(&clip),dotstar_clip_render,&clip,&stats);
+		printf("shown=%u skipped=%u jitter max=%uus mean=%uus\n",
+			stats.frames_shown,stats.frames_skipped,stats.jitter_max_us,stats.jitter_mean_us);
+	}
+
+	dotstar_wait();
+	dotstar_destroy();
+	dotstar_clip_close(&clip);
+}
+
+/*!
+ *	@brief		dotstarServe [seconds]
+ *	@details
+ Serves the strip to other processes through shared memory.
+ *	@param		[in] argc: int argument count
+ *	@param		[in] argv: const char * argv[]
+ *	@retval		none
+ *	@test
+**/
+
+void wrapperDotstarServe(
+	int argc,
+	const char * argv[])
+{
+	struct timespec timeDelay={1,0};
+	dotstar_server_t *server;
+	int seconds=60;
+	int i;
+
+	if(argc>2)
+		seconds=atoi(argv[2]);
+	printf("dotstarServe seconds=%d\n",seconds);
+
+	if(dotstar_create("/dev/spidev1.0", 8000000, 240)!=0)
+		return;
+	dotstar_set_async(1);
+	server=dotstar_server_start(dotstar_get_default(),NULL);
+	if(server!=NULL) {
+		for(i=0;i<seconds;i++) {
+			nanosleep(&timeDelay, NULL);
+			printf("shown=%u dropped=%u\n",dotstar_server_get_shown_frames(server),
+				dotstar_server_get_dropped_frames(server));
+		}
+		dotstar_server_stop(server);
+	}
+	dotstar_wait();
 	dotstar_destroy();
 }
 
+/*!
+ *	@brief		dotstarClient [fps [seconds]]
+ *	@details
+ Draws a moving dot into the shared memory of a running dotstarServe.
+ *	@param		[in] argc: int argument count
+ *	@param		[in] argv: const char * argv[]
+ *	@retval		none
+ *	@test
+**/
+
+void wrapperDotstarClient(
+	int argc,
+	const char * argv[])
+{
+	struct timespec deadline;
+	dotstar_client_t *client;
+	dotstar_rgbb *frame;
+	uint32_t numLEDs;
+	int fps=100;
+	int seconds=10;
+	int i;
+
+	if(argc>2)
+		fps=atoi(argv[2]);
+	if(argc>3)
+		seconds=atoi(argv[3]);
+	if(fps<=0) {
+		printf("Enter a value > 0 for the frame rate.\n");
+		return;
+	}
+	printf("dotstarClient fps=%d seconds=%d\n",fps,seconds);
+
+	client=dotstar_client_open(NULL);
+	if(client==NULL) {
+		printf("No frame server.\n");
+		return;
+	}
+	numLEDs=dotstar_client_num_leds(client);
+
+	clock_gettime(CLOCK_MONOTONIC,&deadline);
+	for(i=0;i<fps*seconds;i++) {
+		frame=dotstar_client_begin_frame(client);
+		if(frame!=NULL) {
+			memset(frame,0,numLEDs*sizeof(dotstar_rgbb));
+			frame[i%numLEDs].r=255;
+			frame[i%numLEDs].g=128;
+			frame[i%numLEDs].brightness=15;
+			dotstar_client_submit(client);
+		}
+		deadline.tv_nsec+=1000000000/fps;
+		if(deadline.tv_nsec>=1000000000) {
+			deadline.tv_nsec-=1000000000;
+			deadline.tv_sec++;
+		}
+		clock_nanosleep(CLOCK_MONOTONIC,TIMER_ABSTIME,&deadline,NULL);
+	}
+	printf("shown=%u dropped=%u\n",dotstar_client_get_shown_frames(client),
+		dotstar_client_get_dropped_frames(client));
+	dotstar_client_close(client);
+}
+
+/*!
+ *	@brief		dotstarBench [count [iterations]]
+ *	@details
+ Times each pixel kernel over a buffer of count pixels and prints the average
+ time per call for every kernel set in the build. The default count is 240,
+ the length of the strip, and the default iterations is 10000.
+ *	@param		[in] argc: int argument count
+ *	@param		[in] argv: const char * argv[]
+ *	@retval		none
+ *	@test
+**/
+
+void wrapperDotstarBench(
+	int argc,
+	const char * argv[])
+{
+	const dotstar_kernel_set * sets[]={
+		&dotstar_kernels_scalar,
+#if defined(__ARM_NEON)
+		&dotstar_kernels_neon,
+#endif
+	};
+	uint32_t count=240;
+	uint32_t iterations=10000;
+	uint32_t *dst,*a,*b;
+	dotstar_planes planes;
+	struct timespec startTime,endTime;
+	uint32_t i;
+	size_t k,s;
+
+	if(argc>2)
+		count=atoi(argv[2]);
+	if(argc>3)
+		iterations=atoi(argv[3]);
+	printf("dotstarBench count=%u iterations=%u\n",count,iterations);
+
+	dst=(uint32_t *)malloc(count*4);
+	a=(uint32_t *)malloc(count*4);
+	b=(uint32_t *)malloc(count*4);
+	if(dst==NULL || a==NULL || b==NULL) {
+		printf("Can't allocate pixel buffers.\n");
+		free(dst); free(a); free(b);
+		return;
+	}
+	for(i=0;i<count;i++) {
+		a[i]=dotstar_kernel_pixel(i,255-i,i*3,i);
+		b[i]=dotstar_kernel_pixel(255-i,i,i*5,15-i);
+	}
+	// The planes reuse b, which holds 4 bytes per pixel.
+	planes.r=(uint8_t *)b;
+	planes.g=planes.r+count;
+	planes.b=planes.g+count;
+	planes.brightness=planes.b+count;
+
+	for(s=0;s<ARRAY_SIZE(sets);s++) {
+		const dotstar_kernel_set *set=sets[s];
+		for(k=0;k<9;k++) {
+			static const char *names[]={"fill","gradient","scale","lerp","add","multiply","select","pack","unpack"};
+			clock_gettime(CLOCK_MONOTONIC,&startTime);
+			for(i=0;i<iterations;i++) {
+				switch(k) {
+					case 0: set->fill(dst,count,a[i%count]); break;
+					case 1: set->gradient(dst,count,a[0],b[0],0,count); break;
+					case 2: set->scale(dst,a,count,i,128,255-i); break;
+					case 3: set->lerp(dst,a,b,count,i&0xFF); break;
+					case 4: set->add(dst,b,count); break;
+					case 5: set->multiply(dst,a,count); break;
+					case 6: set->select(dst,a,dst,(const uint8_t *)b,count,i&0xFF); break;
+					case 7: set->pack(dst,&planes,count); break;
+					case 8: set->unpack(&planes,a,count); break;
+				}
+			}
+			clock_gettime(CLOCK_MONOTONIC,&endTime);
+			printf("%-8s %-8s %8.1f ns/call\n",set->name,names[k],
+				((endTime.tv_sec-startTime.tv_sec)*1e9+(endTime.tv_nsec-startTime.tv_nsec))/iterations);
+		}
+	}
+
+	free(dst);
+	free(a);
+	free(b);
+}
+
 /*!
  *	@brief		asynchronous playback callback
  *	@details	ALSA callback writes sine wave to audio output
@@ -803,188 +1415,48 @@ void done_audio()
 }
 
 /*!
-*	@brief		Pulse the backlight LED brightness once. 
+*	@brief		Wait for the backlight animator to finish. 
 *	@details
-This function pulses the backlight LED by animating the brightness. It is 
-animated from a start brightness value to an end value over a duration of time
-in milliseconds. The initial value can be skipped, which can be useful when 
-chaining together a series of animations.
-
-NOTE that the grayscale value is not changed, so it can be controlled
-outside of this function.
+The backlight commands queue their animations and return at once. The test
+commands wait here so the program does not exit while the animation runs.
+If writing the backlight fails, the rest of the animation is canceled.
 
 @return		Backlight error codes returned by the driver.
-
-@param start The starting brightness value.
-@param end The ending brightness value.
-@param durationMS The duration of the animation.
-@param skipFirst Set to true to skip the start value.
 */
-BacklightErrEnum BacklightAnimateBrightness(
-	BacklightBrightness start, 
-	BacklightBrightness end, 
-	uint32_t durationMS,
-	bool skipFirst)
+BacklightErrEnum BacklightAnimWait(void)
 {
-	const struct timespec	timeDelay = {0, ANIMATION_INC_MS * NSEC_PER_MSECS};
-	struct timespec			startTime;
-	struct timespec			currentTime;
-	uint32_t				deltaTimeMS;
-	long					range;
+	const struct timespec	timeDelay = {0, BACKLIGHT_ANIM_STEP_MS * NSEC_PER_MSECS};
 	BacklightErrEnum		err;
-	BacklightBrightness		current;
 
-	clock_gettime(CLOCK_MONOTONIC_RAW, &startTime);
-	range = end - start;
 	err = BacklightNoErr;
-	while (BacklightNoErr == err)
+	while (BacklightNoErr == err && BacklightAnimBusy())
 	{
-		clock_gettime(CLOCK_MONOTONIC_RAW, &currentTime);
-		deltaTimeMS = (currentTime.tv_sec - startTime.tv_sec) * MSECS_PER_SECOND +
-			(currentTime.tv_nsec - startTime.tv_nsec) / NSEC_PER_MSECS;
-		if (skipFirst)
-		{
-			deltaTimeMS += ANIMATION_INC_MS;
-		}
-		if (deltaTimeMS > durationMS)
-		{
-			current = end;
-		}
-		else
-		{
-			current = start + ((range * (long)deltaTimeMS) / (long)durationMS);
-		}
-		err = SetBrightness(current, BACKLIGHT_BRIGHTNESS_MIN, true);
-		if (deltaTimeMS >= durationMS)
-		{
-			break;
-		}
 		nanosleep(&timeDelay, NULL);
+		err = BacklightAnimLastErr();
 	}
-
-	return err;
-}
-
-/*!
-*	@brief		Pulse the backlight LED grayscale once. 
-*	@details
-This function pulses the backlight LED by animating the grayscale. It is 
-animated from a start grayscale value to an end value over a duration of time
-in milliseconds. The initial value can be skipped, which can be useful when 
-chaining together a series of animations.
-
-NOTE that the brightness value is not changed, so it can be controlled
-outside of this function.
-
-@return		Backlight error codes returned by the driver.
-
-@param start The starting grayscale value.
-@param end The ending grayscale value.
-@param durationMS The duration of the animation.
-@param skipFirst Set to true to skip the start value.
-*/
-BacklightErrEnum BacklightAnimateGrayscale(
-	BacklightGrayscale start, 
-	BacklightGrayscale end, 
-	uint32_t durationMS,
-	bool skipFirst)
-{
-	const struct timespec	timeDelay = {0, ANIMATION_INC_MS * NSEC_PER_MSECS};
-	struct timespec			startTime;
-	struct timespec			currentTime;
-	uint32_t				deltaTimeMS;
-	long					range;
-	BacklightErrEnum		err;
-	BacklightGrayscale		current;
-
-	clock_gettime(CLOCK_MONOTONIC_RAW, &startTime);
-	range = end - start;
-	err = BacklightNoErr;
-	while (BacklightNoErr == err)
+	if (BacklightNoErr != err)
 	{
-		clock_gettime(CLOCK_MONOTONIC_RAW, &currentTime);
-		deltaTimeMS = (currentTime.tv_sec - startTime.tv_sec) * MSECS_PER_SECOND +
-			(currentTime.tv_nsec - startTime.tv_nsec) / NSEC_PER_MSECS;
-		if (skipFirst)
-		{
-			deltaTimeMS += ANIMATION_INC_MS;
-		}
-		if (deltaTimeMS > durationMS)
-		{
-			current = end;
-		}
-		else
-		{
-			current = start + ((range * (long)deltaTimeMS) / (long)durationMS);
-		}
-		err = SetGrayscale(current, BACKLIGHT_GRAYSCALE_MIN, true);
-		if (deltaTimeMS >= durationMS)
-		{
-			break;
-		}
-		nanosleep(&timeDelay, NULL);
+		BacklightAnimCancelAll();
 	}
 
 	return err;
 }
 
 /*!
-*	@brief		Blink the backlight LED some number of times. 
+*	@brief		Look up an easing curve by name. 
 *	@details
-This function blinks the backlight LED. It is turned off and then on. Off is
-a brightness of 0. The on brightness is a combination of the brightness and
-grayscaled parameters. The off and on times are defined by caller supplied
-parameters. The LED is initially turned off. The number of blinks is also
-a parameter.
+The names are the ones in BACKLIGHT_EASE_LIST. An unknown name is linear.
 
-@return		Backlight error codes returned by the driver.
+@return		The easing curve.
 
-@param brightness The "on" brightness value.
-@param grayscale The "on" grayscale value.
-@param onMS The duration of the on part of the duty cycle in milliseconds.
-@param offMS The duration of the off part of the duty cycle in milliseconds.
-@param blinkCount The number of blinks.
+@param name The curve name.
 */
-BacklightErrEnum BacklightBlink(
-	BacklightBrightness brightness, 
-	BacklightGrayscale grayscale, 
-	uint32_t onMS, uint32_t offMS, int blinkCount)
+BacklightEaseEnum BacklightEaseParse(const char *name)
 {
-	BacklightErrEnum	err;
-	int					iBlink;
-	struct timespec		timeDelay = {0, 0};
-	struct timespec		timeRemaining;
-
-	//Set the grayscale to the on value and then blink using brightness.
-	err = SetGrayscale(grayscale, BACKLIGHT_GRAYSCALE_MIN, false);
-
-	err = SetBrightness(BACKLIGHT_BRIGHTNESS_MIN, BACKLIGHT_BRIGHTNESS_MIN, true);
-	if (BacklightNoErr != err) return err;
-
-	for (iBlink = 0; iBlink < blinkCount; iBlink++)
-	{
-		timeDelay.tv_sec = offMS / MSECS_PER_SECOND;
-		timeDelay.tv_nsec = (offMS % MSECS_PER_SECOND) * NSEC_PER_MSECS;
-		while(nanosleep(&timeDelay, &timeRemaining) < 0 && (timeRemaining.tv_sec > 0 || timeRemaining.tv_nsec > 0))
-		{
-			timeDelay.tv_sec = timeRemaining.tv_sec;
-			timeDelay.tv_nsec = timeRemaining.tv_nsec;
-		};
-
-		err = SetBrightness(brightness, BACKLIGHT_BRIGHTNESS_MIN, true);
-		if (BacklightNoErr != err) return err;
-
-		timeDelay.tv_sec = onMS / MSECS_PER_SECOND;
-		timeDelay.tv_nsec = (onMS % MSECS_PER_SECOND) * NSEC_PER_MSECS;
-		while(nanosleep(&timeDelay, &timeRemaining) < 0 && (timeRemaining.tv_sec > 0 || timeRemaining.tv_nsec > 0))
-		{
-			timeDelay.tv_sec = timeRemaining.tv_sec;
-			timeDelay.tv_nsec = timeRemaining.tv_nsec;
-		};
-
-		err = SetBrightness(BACKLIGHT_BRIGHTNESS_MIN, BACKLIGHT_BRIGHTNESS_MIN, true);
-		if (BacklightNoErr != err) return err;
-	}
-
-	return err;
+#define BACKLIGHT_EASE_(enumTag, easeName, lut) \
+	if (strcmp(name, easeName) == 0) return enumTag;
+	BACKLIGHT_EASE_LIST
+#undef BACKLIGHT_EASE_
+	printf("Unknown ease '%s', using %s\n", name, BacklightEaseName(BacklightEaseLinear));
+	return BacklightEaseLinear;
 }
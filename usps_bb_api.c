@@ -17,25 +17,103 @@
 #include "usps_bb_api.h"
 #include "dotstar.h"
 #include "Backlight.h"
+#include "BacklightAnim.h"
 #include "SegmentDisplay.h"
 
 #include <stdio.h>
 #include <string.h>
 
-static const char *cDevice="/dev/spidev1.0";
-static const uint16_t cNumLEDs=240;
+//LED_STRIP_(device, frequency, numLEDs)
+//Add a line per strip, e.g. LED_STRIP_("/dev/spidev1.1", 8000000, 240)
+#define LED_STRIP_LIST \
+LED_STRIP_("/dev/spidev1.0"	,8000000	,240	) \
+//Comment terminates list macro. Do not delete.
+
+typedef struct
+{
+	const char *device;
+	uint32_t frequency;
+	uint32_t numLEDs;
+} usps_bb_led_strip_config;
+
+static const usps_bb_led_strip_config cStrips[]={
+#define LED_STRIP_(device, frequency, numLEDs) {device, frequency, numLEDs},
+	LED_STRIP_LIST
+#undef LED_STRIP_
+};
+
+#define LED_STRIP_COUNT (sizeof(cStrips)/sizeof(cStrips[0]))
+
 static const uint16_t cCenter=5;
 
+// Strip 0 is opened with dotstar_create() and stays the default strip.
+static dotstar_t *ledStrips[LED_STRIP_COUNT];
+static uint8_t ledSelected=0;
+
+// Layers for LED_ZONE_LIST. Layer numbers match usps_bb_led_zone.
+static dotstar_compositor_t *ledCompositor=NULL;
+
+// Only strip 0 falls back to the default strip. usps_bb_led_select_strip()
+// never selects another strip that did not open.
+static dotstar_t *usps_bb_led_strip()
+{
+	if (ledSelected==0 && ledStrips[0]==NULL) {
+		return dotstar_get_default();
+	}
+	return ledStrips[ledSelected];
+}
+
 /*!
  *	@brief		led initialize
- *	@details
+ *	@details	Opens every strip in LED_STRIP_LIST. With more than one
+ 	strip, each gets its own writer thread so usps_bb_led_show() puts
+ 	the strips on the wire at the same time. Sets up a compositor layer
+ 	on strip 0 for each zone in LED_ZONE_LIST. If a zone does not fit on
+ 	strip 0, no zones are set up and the zone functions do nothing.
  *	@retval		none
  *	@test
 **/
 
 void usps_bb_led_initialize()
 {
-	dotstar_create(cDevice,8000000,cNumLEDs);
+	for (uint8_t i=0;i<LED_STRIP_COUNT;i++) {
+		if (i==0) {
+			if (dotstar_create(cStrips[i].device,cStrips[i].frequency,cStrips[i].numLEDs)==0) {
+				ledStrips[i]=dotstar_get_default();
+			}
+		} else {
+			ledStrips[i]=dotstar_h_open(cStrips[i].device,cStrips[i].frequency,cStrips[i].numLEDs);
+		}
+		if (ledStrips[i]!=NULL && LED_STRIP_COUNT>1) {
+			dotstar_h_set_async(ledStrips[i],1);
+		}
+	}
+	ledSelected=0;
+
+	if (ledStrips[0]!=NULL) {
+		uint32_t numLEDs=dotstar_h_num_leds(ledStrips[0]);
+		int fits=1;
+#define LED_ZONE_(enumTag, name, offset, count, mode, alpha) \
+		if ((uint32_t)(offset)+(count)>numLEDs) { \
+			printf("LED zone %s ends at %u, strip 0 has %u LEDs.\n",name,(unsigned)((offset)+(count)),(unsigned)numLEDs); \
+			fits=0; \
+		}
+		LED_ZONE_LIST
+#undef LED_ZONE_
+		if (fits) {
+			ledCompositor=dotstar_comp_create(ledStrips[0],LedZoneCOUNT);
+#define LED_ZONE_(enumTag, name, offset, count, mode, alpha) \
+			if (dotstar_comp_add_layer(ledCompositor,name,offset,count,mode,alpha)!=enumTag) { \
+				fits=0; \
+			}
+			LED_ZONE_LIST
+#undef LED_ZONE_
+			if (!fits) {
+				dotstar_comp_destroy(ledCompositor);
+				ledCompositor=NULL;
+			}
+		}
+	}
 }
 
 /*!
@@ -47,7 +125,49 @@ void usps_bb_led_initialize()
 
 void usps_bb_led_done()
 {
+	for (uint8_t i=1;i<LED_STRIP_COUNT;i++) {
+		dotstar_h_close(ledStrips[i]);
+		ledStrips[i]=NULL;
+	}
+	dotstar_comp_destroy(ledCompositor);
+	ledCompositor=NULL;
 	dotstar_destroy();
+	ledStrips[0]=NULL;
+	ledSelected=0;
+}
+
+/*!
+ *	@brief		get led strip count
+ *	@details	The number of strips in LED_STRIP_LIST.
+ *	@retval		uint8_t
+ *	@test
+**/
+
+uint8_t usps_bb_led_get_strip_count()
+{
+	return LED_STRIP_COUNT;
+}
+
+/*!
+ *	@brief		select led strip
+ *	@details	The pixel and strip functions act on the selected strip.
+ 	usps_bb_led_show(), usps_bb_led_set_async() and usps_bb_led_wait()
+ 	act on all strips. Strip 0 is selected by default. Any other strip
+ 	must have opened in usps_bb_led_initialize().
+ *	@param		[in] strip: uint8_t strip number, starting at 0
+ *	@retval		uint8_t 0 on success, 1 if there is no such strip or it
+ 	is not open
+ *	@test
+**/
+
+uint8_t usps_bb_led_select_strip(
+	uint8_t strip)
+{
+	if (strip>=LED_STRIP_COUNT || (strip>0 && ledStrips[strip]==NULL)) {
+		return 1;
+	}
+	ledSelected=strip;
+	return 0;
 }
 
 /*!
@@ -59,25 +179,162 @@ void usps_bb_led_done()
 
 void usps_bb_led_clear()
 {
-	dotstar_clear();
+	dotstar_h_clear(usps_bb_led_strip());
 }
 
 /*!
  *	@brief		led show 
- *	@details
+ *	@details	Shows every strip. A strip that has not changed since its
+ 	last frame was sent is skipped and does not use the bus.
  *	@retval		none
  *	@test
 **/
 
 void usps_bb_led_show()
 {
-	dotstar_show();
+	for (uint8_t i=0;i<LED_STRIP_COUNT;i++) {
+		if (ledStrips[i]!=NULL) {
+			dotstar_h_show(ledStrips[i]);
+		}
+	}
+}
+
+/*!
+ *	@brief		led show force
+ *	@details	Shows every strip, even those that have not changed.
+ *	@retval		none
+ *	@test
+**/
+
+void usps_bb_led_show_force()
+{
+	for (uint8_t i=0;i<LED_STRIP_COUNT;i++) {
+		if (ledStrips[i]!=NULL) {
+			dotstar_h_show_force(ledStrips[i]);
+		}
+	}
+}
+
+/*!
+ *	@brief		set led asynchronous output
+ *	@details	When enabled, usps_bb_led_show() queues the frame for a
+ 	writer thread and returns immediately. A frame that is still queued
+ 	when the next one is shown is replaced and counted as dropped.
+ *	@param		[in] enable: uint8_t nonzero to enable
+ *	@retval		none
+ *	@test
+**/
+
+void usps_bb_led_set_async(
+	uint8_t enable)
+{
+	for (uint8_t i=0;i<LED_STRIP_COUNT;i++) {
+		if (ledStrips[i]!=NULL) {
+			dotstar_h_set_async(ledStrips[i],enable);
+		}
+	}
+}
+
+/*!
+ *	@brief		set led output queue
+ *	@details	Sets how many frames can wait for each writer thread and
+ 	what usps_bb_led_show() does when a queue is full.
+ *	@param		[in] depth: uint8_t queue depth, a power of two up to
+ 	DOTSTAR_QUEUE_MAX_DEPTH
+ *	@param		[in] policy: dotstar_queue_policy
+ *	@retval		uint8_t 0 on success, 1 if the depth is not supported
+ *	@test
+**/
+
+uint8_t usps_bb_led_set_queue(
+	uint8_t depth,
+	dotstar_queue_policy policy)
+{
+	for (uint8_t i=0;i<LED_STRIP_COUNT;i++) {
+		if (ledStrips[i]!=NULL && dotstar_h_set_queue(ledStrips[i],depth,policy)!=0) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/*!
+ *	@brief		wait for led output
+ *	@details	Blocks until every shown frame has been written to the strips.
+ *	@retval		none
+ *	@test
+**/
+
+void usps_bb_led_wait()
+{
+	for (uint8_t i=0;i<LED_STRIP_COUNT;i++) {
+		if (ledStrips[i]!=NULL) {
+			dotstar_h_wait(ledStrips[i]);
+		}
+	}
+}
+
+/*!
+ *	@brief		get led dropped frames
+ *	@details	Frames replaced by a newer frame before they were written,
+ 	summed over all strips.
+ *	@retval		uint32_t
+ *	@test
+**/
+
+uint32_t usps_bb_led_get_dropped_frames()
+{
+	uint32_t dropped=0;
+	for (uint8_t i=0;i<LED_STRIP_COUNT;i++) {
+		if (ledStrips[i]!=NULL) {
+			dropped+=dotstar_h_get_dropped_frames(ledStrips[i]);
+		}
+	}
+	return dropped;
+}
+
+/*!
+ *	@brief		get led sent frames
+ *	@details	Frames put on the bus or queued for it, summed over all
+ 	strips.
+ *	@retval		uint32_t
+ *	@test
+**/
+
+uint32_t usps_bb_led_get_sent_frames()
+{
+	uint32_t sent=0;
+	for (uint8_t i=0;i<LED_STRIP_COUNT;i++) {
+		if (ledStrips[i]!=NULL) {
+			sent+=dotstar_h_get_sent_frames(ledStrips[i]);
+		}
+	}
+	return sent;
+}
+
+/*!
+ *	@brief		get led skipped frames
+ *	@details	Frames not sent because the strip had not changed, summed
+ 	over all strips.
+ *	@retval		uint32_t
+ *	@test
+**/
+
+uint32_t usps_bb_led_get_skipped_frames()
+{
+	uint32_t skipped=0;
+	for (uint8_t i=0;i<LED_STRIP_COUNT;i++) {
+		if (ledStrips[i]!=NULL) {
+			skipped+=dotstar_h_get_skipped_frames(ledStrips[i]);
+		}
+	}
+	return skipped;
 }
 
 /*!
  *	@brief		set led pixel
  *	@details
- *	@param		[in] pixel: uint16_t pixel number
+ *	@param		[in] pixel: uint32_t pixel number
  *	@param		[in] r: uint8_t red
  *	@param		[in] g: uint8_t green
  *	@param		[in] b: uint8_t blue
@@ -87,135 +344,177 @@ void usps_bb_led_show()
 **/
 
 void usps_bb_led_set_pixel(
-	uint16_t pixel,
+	uint32_t pixel,
 	uint8_t r,
 	uint8_t g,
 	uint8_t b,
 	uint8_t brightness)
 {
-	dotstar_set_pixel(pixel,r,g,b,brightness);
+	dotstar_h_set_pixel(usps_bb_led_strip(),pixel,r,g,b,brightness);
+}
+
+/*!
+ *	@brief		set led pixels
+ *	@details	Sets a run of pixels with one call. The run is clipped to
+ 	the end of the strip.
+ *	@param		[in] offset: uint32_t first pixel number
+ *	@param		[in] count: uint32_t number of pixels
+ *	@param		[in] pixels: const usps_bb_rgbb * r, g, b and brightness
+ 	maximum 15 for each pixel
+ *	@retval		none
+ *	@test
+**/
+
+void usps_bb_led_set_pixels(
+	uint32_t offset,
+	uint32_t count,
+	const usps_bb_rgbb *pixels)
+{
+	dotstar_h_set_pixels(usps_bb_led_strip(),offset,count,pixels);
+}
+
+/*!
+ *	@brief		set led pixels packed
+ *	@details	Sets a run of pixels from data in the strip wire format,
+ 	4 bytes per pixel: the start bits ORed with the 5-bit brightness, then
+ 	the colors in the order of the build's chipset (DOTSTAR_CHIPSET_LIST in
+ 	dotstar_chipset.h). The data is copied as is. The run is clipped to the
+ 	end of the strip.
+ *	@param		[in] offset: uint32_t first pixel number
+ *	@param		[in] count: uint32_t number of pixels
+ *	@param		[in] pixels: const uint32_t * packed pixels
+ *	@retval		none
+ *	@test
+**/
+
+void usps_bb_led_set_pixels_packed(
+	uint32_t offset,
+	uint32_t count,
+	const uint32_t *pixels)
+{
+	dotstar_h_set_pixels_packed(usps_bb_led_strip(),offset,count,pixels);
 }
 
 /*!
  *	@brief		set led pixel red
  *	@details
- *	@param		[in] pixel: uint16_t pixel number
+ *	@param		[in] pixel: uint32_t pixel number
  *	@param		[in] r: uint8_t red
  *	@retval		none
  *	@test
 **/
 
 void usps_bb_led_set_pixel_red(
-	uint16_t pixel,
+	uint32_t pixel,
 	uint8_t r)
 {
-	dotstar_set_pixel_red(pixel,r);
+	dotstar_h_set_pixel_red(usps_bb_led_strip(),pixel,r);
 }
 
 /*!
  *	@brief		set led pixel green
  *	@details
- *	@param		[in] pixel: uint16_t pixel number
+ *	@param		[in] pixel: uint32_t pixel number
  *	@param		[in] g: uint8_t green
  *	@retval		none
  *	@test
 **/
 
 void usps_bb_led_set_pixel_green(
-	uint16_t pixel,
+	uint32_t pixel,
 	uint8_t g)
 {
-	dotstar_set_pixel_green(pixel,g);
+	dotstar_h_set_pixel_green(usps_bb_led_strip(),pixel,g);
 }
 
 /*!
  *	@brief		set led pixel blue
  *	@details
- *	@param		[in] pixel: uint16_t pixel number
+ *	@param		[in] pixel: uint32_t pixel number
  *	@param		[in] b: uint8_t blue
  *	@retval		none
  *	@test
 **/
 
 void usps_bb_led_set_pixel_blue(
-	uint16_t pixel,
+	uint32_t pixel,
 	uint8_t b)
 {
-	dotstar_set_pixel_blue(pixel,b);
+	dotstar_h_set_pixel_blue(usps_bb_led_strip(),pixel,b);
 }
 
 /*!
  *	@brief		set led pixel brightness
  *	@details
- *	@param		[in] pixel: uint16_t pixel number
+ *	@param		[in] pixel: uint32_t pixel number
  *	@param		[in] brightness: uint8_t brightness maximum 15
  *	@retval		none
  *	@test
 **/
 
 void usps_bb_led_set_pixel_brightness(
-	uint16_t pixel,
+	uint32_t pixel,
 	uint8_t brightness)
 {
-	dotstar_set_pixel_brightness(pixel,brightness);
+	dotstar_h_set_pixel_brightness(usps_bb_led_strip(),pixel,brightness);
 }
 
 /*!
  *	@brief		get led pixel red
  *	@details
- *	@param		[in] pixel: uint16_t pixel number
+ *	@param		[in] pixel: uint32_t pixel number
  *	@retval		r: uint8_t
  *	@test
 **/
 
 uint8_t usps_bb_led_get_pixel_red(
-	uint16_t pixel)
+	uint32_t pixel)
 {
-	return dotstar_get_pixel_red(pixel);
+	return dotstar_h_get_pixel_red(usps_bb_led_strip(),pixel);
 }
 
 /*!
  *	@brief		get led pixel green 
  *	@details
- *	@param		[in] pixel: uint16_t pixel number
+ *	@param		[in] pixel: uint32_t pixel number
  *	@retval		g: uint8_t
  *	@test
 **/
 
 uint8_t usps_bb_led_get_pixel_green(
-	uint16_t pixel)
+	uint32_t pixel)
 {
-	return dotstar_get_pixel_green(pixel);
+	return dotstar_h_get_pixel_green(usps_bb_led_strip(),pixel);
 }
 
 
 /*!
  *	@brief		get led pixel blue
  *	@details
- *	@param		[in] pixel: uint16_t pixel number
+ *	@param		[in] pixel: uint32_t pixel number
  *	@retval		b: uint8_t
  *	@test
 **/
 
 uint8_t usps_bb_led_get_pixel_blue(
-	uint16_t pixel)
+	uint32_t pixel)
 {
-	return dotstar_get_pixel_blue(pixel);
+	return dotstar_h_get_pixel_blue(usps_bb_led_strip(),pixel);
 }
 
 
 /*!
  *	@brief		get led pixel brightness
  *	@details
- *	@param		[in] pixel: uint16_t pixel number
+ *	@param		[in] pixel: uint32_t pixel number
  *	@retval		brightness: uint8_t
  *	@test
 **/
 
 uint8_t usps_bb_led_get_pixel_brightness(
-	uint16_t pixel)
+	uint32_t pixel)
 {
-	return dotstar_get_pixel_brightness(pixel);
+	return dotstar_h_get_pixel_brightness(usps_bb_led_strip(),pixel);
 }
 
 /*!
@@ -235,7 +534,7 @@ void usps_bb_led_set(
 	uint8_t b,
 	uint8_t brightness)
 {
-	dotstar_set_strip(r,g,b,brightness);
+	dotstar_h_set_strip(usps_bb_led_strip(),r,g,b,brightness);
 }
 
 /*!
@@ -255,7 +554,7 @@ void usps_bb_led_push_pixel_front(
 	uint8_t b,
 	uint8_t brightness)
 {
-	dotstar_strip_push_pixel_front(r,g,b,brightness);
+	dotstar_h_strip_push_pixel_front(usps_bb_led_strip(),r,g,b,brightness);
 }
 
 /*!
@@ -275,7 +574,7 @@ void usps_bb_led_push_pixel_back(
 	uint8_t b,
 	uint8_t brightness)
 {
-	dotstar_strip_push_pixel_back(r,g,b,brightness);
+	dotstar_h_strip_push_pixel_back(usps_bb_led_strip(),r,g,b,brightness);
 }
 
 /*!
@@ -287,7 +586,7 @@ void usps_bb_led_push_pixel_back(
 
 void usps_bb_led_rotate_left()
 {
-	dotstar_strip_rotate_left();
+	dotstar_h_strip_rotate_left(usps_bb_led_strip());
 }
 
 /*!
@@ -299,7 +598,138 @@ void usps_bb_led_rotate_left()
 
 void usps_bb_led_rotate_right()
 {
-	dotstar_strip_rotate_right();
+	dotstar_h_strip_rotate_right(usps_bb_led_strip());
+}
+
+/*!
+ *	@brief		get led zone pixels
+ *	@details	The zone's layer buffer to draw into, in the strip wire
+ 	format. Index 0 is the first pixel of the zone. The zone is marked
+ 	dirty. Call usps_bb_led_zone_mark_dirty() after drawing into a
+ 	buffer that was fetched earlier.
+ *	@param		[in] zone: usps_bb_led_zone zone
+ *	@param		[out] count: uint32_t * pixels in the zone, may be NULL
+ *	@retval		uint32_t * buffer, NULL if the strip is not open
+ *	@test
+**/
+
+uint32_t *usps_bb_led_zone_pixels(
+	usps_bb_led_zone zone,
+	uint32_t *count)
+{
+	return dotstar_comp_layer_pixels(ledCompositor,zone,count);
+}
+
+/*!
+ *	@brief		set led zone
+ *	@details	Sets every pixel of the zone's layer.
+ *	@param		[in] zone: usps_bb_led_zone zone
+ *	@param		[in] r: uint8_t red
+ *	@param		[in] g: uint8_t green
+ *	@param		[in] b: uint8_t blue
+ *	@param		[in] brightness: uint8_t brightness
+ *	@retval		none
+ *	@test
+**/
+
+void usps_bb_led_zone_set(
+	usps_bb_led_zone zone,
+	uint8_t r,
+	uint8_t g,
+	uint8_t b,
+	uint8_t brightness)
+{
+	dotstar_comp_layer_fill(ledCompositor,zone,r,g,b,brightness);
+}
+
+/*!
+ *	@brief		set led zone alpha
+ *	@details	255 is opaque and 0 hides the zone.
+ *	@param		[in] zone: usps_bb_led_zone zone
+ *	@param		[in] alpha: uint8_t alpha
+ *	@retval		none
+ *	@test
+**/
+
+void usps_bb_led_zone_set_alpha(
+	usps_bb_led_zone zone,
+	uint8_t alpha)
+{
+	dotstar_comp_set_alpha(ledCompositor,zone,alpha);
+}
+
+/*!
+ *	@brief		set led zone visible
+ *	@details	A hidden zone shows the zones below it.
+ *	@param		[in] zone: usps_bb_led_zone zone
+ *	@param		[in] visible: uint8_t nonzero to show
+ *	@retval		none
+ *	@test
+**/
+
+void usps_bb_led_zone_set_visible(
+	usps_bb_led_zone zone,
+	uint8_t visible)
+{
+	dotstar_comp_set_visible(ledCompositor,zone,visible);
+}
+
+/*!
+ *	@brief		mark led zone dirty
+ *	@details	Redraw the zone on the next usps_bb_led_compose().
+ *	@param		[in] zone: usps_bb_led_zone zone
+ *	@retval		none
+ *	@test
+**/
+
+void usps_bb_led_zone_mark_dirty(
+	usps_bb_led_zone zone)
+{
+	dotstar_comp_mark_dirty(ledCompositor,zone);
+}
+
+/*!
+ *	@brief		led compose
+ *	@details	Blends the zones that changed since the last call into
+ 	strip 0. Call usps_bb_led_show() afterwards to send the frame.
+ *	@retval		none
+ *	@test
+**/
+
+void usps_bb_led_compose()
+{
+	dotstar_comp_flatten(ledCompositor);
+}
+
+/*!
+ *	@brief		backlight initialize
+ *	@details	Opens and configures the backlight spi device. It stays
+ 	open until usps_bb_backlight_done(), so each usps_bb_backlight_show()
+ 	is a single transfer. Optional: the first show opens it as well.
+ *	@retval		none
+ *	@test
+**/
+
+void usps_bb_backlight_initialize()
+{
+	BacklightErrEnum err=BacklightOpen();
+	if (err!=BacklightNoErr) {
+		printf("Backlight: %s\n",BacklightErrDesc(err));
+	}
+}
+
+/*!
+ *	@brief		backlight done
+ *	@details	Stops the backlight animator and closes the backlight
+ 	spi device. The backlight keeps its current state.
+ *	@retval		none
+ *	@test
+**/
+
+void usps_bb_backlight_done()
+{
+	BacklightAnimStop();
+	BacklightClose();
 }
 
 /*!
@@ -339,7 +769,7 @@ void usps_bb_backlight_set_grayscale(
 
 void usps_bb_backlight_show()
 {
-	BacklightUpdateLEDs();
+	BacklightFlush();
 }
 
 /*!
@@ -379,6 +809,19 @@ void usps_bb_display_initialize()
 	SegDispInit();
 }
 
+/*!
+ *	@brief		display done
+ *	@details	Closes the display i2c device, which otherwise stays open
+ 	between updates. The display keeps showing its text.
+ *	@retval		none
+ *	@test
+**/
+
+void usps_bb_display_done()
+{
+	SegDispClose();
+}
+
 /*!
  *	@brief		set display text
  *	@details	There are two 4 character alphanumeric segmented
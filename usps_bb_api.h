@@ -18,27 +18,68 @@
 
 #include <stdint.h>
 
+#include "dotstar.h"
+#include "dotstar_compositor.h"
+
+typedef dotstar_rgbb usps_bb_rgbb;
+
+//LED_ZONE_(enumTag, name, offset, count, mode, alpha)
+//Zones of strip 0, drawn through the compositor. Each zone is a layer and
+//later zones are drawn over earlier ones.
+#define LED_ZONE_LIST \
+LED_ZONE_(LedZoneIdle		,"idle"		,0	,240	,DOTSTAR_BLEND_NORMAL	,255	) \
+LED_ZONE_(LedZoneProgress	,"progress"	,24	,192	,DOTSTAR_BLEND_NORMAL	,255	) \
+LED_ZONE_(LedZoneStatus		,"status"	,0	,24		,DOTSTAR_BLEND_NORMAL	,255	) \
+//Comment terminates list macro. Do not delete.
+
+typedef enum
+{
+#define LED_ZONE_(enumTag, name, offset, count, mode, alpha) enumTag,
+	LED_ZONE_LIST
+#undef LED_ZONE_
+	LedZoneCOUNT
+} usps_bb_led_zone;
+
 // LED strip
 void usps_bb_led_initialize(void);
 void usps_bb_led_done(void);
+uint8_t usps_bb_led_get_strip_count(void);
+uint8_t usps_bb_led_select_strip(uint8_t strip);
 void usps_bb_led_clear(void);
 void usps_bb_led_show(void);
-void usps_bb_led_set_pixel(uint16_t pixel,uint8_t r,uint8_t g,uint8_t b,uint8_t brightness);
-void usps_bb_led_set_pixel_red(uint16_t pixel,uint8_t r);
-void usps_bb_led_set_pixel_green(uint16_t pixel,uint8_t g);
-void usps_bb_led_set_pixel_blue(uint16_t pixel,uint8_t b);
-void usps_bb_led_set_pixel_brightness(uint16_t pixel,uint8_t brightness);
-uint8_t usps_bb_led_get_pixel_red(uint16_t pixel);
-uint8_t usps_bb_led_get_pixel_green(uint16_t pixel);
-uint8_t usps_bb_led_get_pixel_blue(uint16_t pixel);
-uint8_t usps_bb_led_get_pixel_brightness(uint16_t pixel);
+void usps_bb_led_show_force(void);
+void usps_bb_led_set_async(uint8_t enable);
+uint8_t usps_bb_led_set_queue(uint8_t depth,dotstar_queue_policy policy);
+void usps_bb_led_wait(void);
+uint32_t usps_bb_led_get_dropped_frames(void);
+uint32_t usps_bb_led_get_sent_frames(void);
+uint32_t usps_bb_led_get_skipped_frames(void);
+void usps_bb_led_set_pixel(uint32_t pixel,uint8_t r,uint8_t g,uint8_t b,uint8_t brightness);
+void usps_bb_led_set_pixels(uint32_t offset,uint32_t count,const usps_bb_rgbb *pixels);
+void usps_bb_led_set_pixels_packed(uint32_t offset,uint32_t count,const uint32_t *pixels);
+void usps_bb_led_set_pixel_red(uint32_t pixel,uint8_t r);
+void usps_bb_led_set_pixel_green(uint32_t pixel,uint8_t g);
+void usps_bb_led_set_pixel_blue(uint32_t pixel,uint8_t b);
+void usps_bb_led_set_pixel_brightness(uint32_t pixel,uint8_t brightness);
+uint8_t usps_bb_led_get_pixel_red(uint32_t pixel);
+uint8_t usps_bb_led_get_pixel_green(uint32_t pixel);
+uint8_t usps_bb_led_get_pixel_blue(uint32_t pixel);
+uint8_t usps_bb_led_get_pixel_brightness(uint32_t pixel);
 void usps_bb_led_set(uint8_t r,uint8_t g,uint8_t b,uint8_t brightness);
 void usps_bb_led_push_pixel_front(uint8_t r,uint8_t g,uint8_t b,uint8_t brightness);
 void usps_bb_led_push_pixel_back(uint8_t r,uint8_t g,uint8_t b,uint8_t brightness);
 void usps_bb_led_rotate_left(void);
 void usps_bb_led_rotate_right(void);
+uint32_t *usps_bb_led_zone_pixels(usps_bb_led_zone zone,uint32_t *count);
+void usps_bb_led_zone_set(usps_bb_led_zone zone,uint8_t r,uint8_t g,uint8_t b,uint8_t brightness);
+void usps_bb_led_zone_set_alpha(usps_bb_led_zone zone,uint8_t alpha);
+void usps_bb_led_zone_set_visible(usps_bb_led_zone zone,uint8_t visible);
+void usps_bb_led_zone_mark_dirty(usps_bb_led_zone zone);
+void usps_bb_led_compose(void);
 
 // Backlight
+void usps_bb_backlight_initialize(void);
+void usps_bb_backlight_done(void);
 void usps_bb_backlight_set_brightness(uint8_t brightness);
 void usps_bb_backlight_set_grayscale(uint16_t grayscale);
 void usps_bb_backlight_show(void);
@@ -47,6 +88,7 @@ uint16_t usps_bb_backlight_get_grayscale(void);
 
 // Display
 void usps_bb_display_initialize(void);
+void usps_bb_display_done(void);
 void usps_bb_display_text(const char *text);
 void usps_bb_display_brightness(uint8_t brightness1, uint8_t brightness2);
 void usps_bb_display_blink(uint8_t rate1, uint8_t rate2);